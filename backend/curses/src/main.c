@@ -39,49 +39,60 @@ static int terminal_input_handler(void* ptr, short event, int fd){
   if(!(event & POLLIN))
     return -1;
   (void)ptr;
+  // This is called by the main loop, not by the core, so the backend lock has to be taken here
+  pthread_mutex_lock(&tym_i_backend_lock);
   int c = getch();
-  if(c != ERR)
-  switch(c){
-    case KEY_MOUSE: {
-      MEVENT event;
-      if(getmouse(&event) != OK)
-        break;
-      for(struct tym_i_pane_internal* it=tym_i_pane_list_start; it; it=it->next){
-        int left   = TYM_RECT_POS_REF(it->absolute_position, CHARFIELD, TYM_LEFT  );
-        int right  = TYM_RECT_POS_REF(it->absolute_position, CHARFIELD, TYM_RIGHT );
-        int top    = TYM_RECT_POS_REF(it->absolute_position, CHARFIELD, TYM_TOP   );
-        int bottom = TYM_RECT_POS_REF(it->absolute_position, CHARFIELD, TYM_BOTTOM);
-        if( left > (int)event.x || right <= (int)event.x || top > (int)event.y || bottom <= (int)event.y )
-          continue;
-        unsigned x = event.x - left;
-        unsigned y = event.y - top;
-        tym_i_pane_focus(it);
-        if(event.bstate & (BUTTON1_RELEASED | BUTTON2_RELEASED | BUTTON3_RELEASED)){
-          tym_i_pts_send_mouse_event(it, TYM_BUTTON_RELEASED, (struct tym_i_cell_position){.x=x, .y=y});
-        }
-        if(event.bstate & BUTTON1_PRESSED){
-          tym_i_pts_send_mouse_event(it, TYM_BUTTON_LEFT_PRESSED, (struct tym_i_cell_position){.x=x, .y=y});
-        }
-        if(event.bstate & BUTTON2_PRESSED){
-          tym_i_pts_send_mouse_event(it, TYM_BUTTON_MIDDLE_PRESSED, (struct tym_i_cell_position){.x=x, .y=y});
-        }
-        if(event.bstate & BUTTON3_PRESSED){
-          tym_i_pts_send_mouse_event(it, TYM_BUTTON_RIGHT_PRESSED, (struct tym_i_cell_position){.x=x, .y=y});
-        }
-        break;
+  MEVENT mevent;
+  bool mouse = c == KEY_MOUSE && getmouse(&mevent) == OK;
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  if(c == ERR || (c == KEY_MOUSE && !mouse))
+    return 0;
+  if(mouse){
+    for(struct tym_i_pane_internal* it=tym_i_pane_list_start; it; it=it->next){
+      int left   = TYM_RECT_POS_REF(it->absolute_position, CHARFIELD, TYM_LEFT  );
+      int right  = TYM_RECT_POS_REF(it->absolute_position, CHARFIELD, TYM_RIGHT );
+      int top    = TYM_RECT_POS_REF(it->absolute_position, CHARFIELD, TYM_TOP   );
+      int bottom = TYM_RECT_POS_REF(it->absolute_position, CHARFIELD, TYM_BOTTOM);
+      if( left > (int)mevent.x || right <= (int)mevent.x || top > (int)mevent.y || bottom <= (int)mevent.y )
+        continue;
+      unsigned x = mevent.x - left;
+      unsigned y = mevent.y - top;
+      tym_i_pane_focus(it);
+      pthread_mutex_lock(&it->lock);
+      if(mevent.bstate & (BUTTON1_RELEASED | BUTTON2_RELEASED | BUTTON3_RELEASED)){
+        tym_i_pts_send_mouse_event(it, TYM_BUTTON_RELEASED, (struct tym_i_cell_position){.x=x, .y=y});
+      }
+      if(mevent.bstate & BUTTON1_PRESSED){
+        tym_i_pts_send_mouse_event(it, TYM_BUTTON_LEFT_PRESSED, (struct tym_i_cell_position){.x=x, .y=y});
       }
-    } break;
-    case KEY_ENTER: tym_i_pts_send_key(tym_i_focus_pane, TYM_KEY_ENTER); break;
-    case KEY_UP   : tym_i_pts_send_key(tym_i_focus_pane, TYM_KEY_UP); break;
-    case KEY_DOWN : tym_i_pts_send_key(tym_i_focus_pane, TYM_KEY_DOWN); break;
-    case KEY_RIGHT: tym_i_pts_send_key(tym_i_focus_pane, TYM_KEY_RIGHT); break;
-    case KEY_LEFT : tym_i_pts_send_key(tym_i_focus_pane, TYM_KEY_LEFT); break;
-    case KEY_BACKSPACE: tym_i_pts_send_key(tym_i_focus_pane, TYM_KEY_BACKSPACE); break;
-    case KEY_HOME: tym_i_pts_send_key(tym_i_focus_pane, TYM_KEY_HOME); break;
-    case KEY_END: tym_i_pts_send_key(tym_i_focus_pane, TYM_KEY_END); break;
-    case KEY_DC: tym_i_pts_send_key(tym_i_focus_pane, TYM_KEY_DELETE); break;
-    default: tym_i_pts_send_key(tym_i_focus_pane, c); break;
+      if(mevent.bstate & BUTTON2_PRESSED){
+        tym_i_pts_send_mouse_event(it, TYM_BUTTON_MIDDLE_PRESSED, (struct tym_i_cell_position){.x=x, .y=y});
+      }
+      if(mevent.bstate & BUTTON3_PRESSED){
+        tym_i_pts_send_mouse_event(it, TYM_BUTTON_RIGHT_PRESSED, (struct tym_i_cell_position){.x=x, .y=y});
+      }
+      pthread_mutex_unlock(&it->lock);
+      break;
+    }
+    return 0;
+  }
+  struct tym_i_pane_internal* pane = tym_i_focus_pane;
+  if(!pane)
+    return 0;
+  pthread_mutex_lock(&pane->lock);
+  switch(c){
+    case KEY_ENTER: tym_i_pts_send_key(pane, TYM_KEY_ENTER); break;
+    case KEY_UP   : tym_i_pts_send_key(pane, TYM_KEY_UP); break;
+    case KEY_DOWN : tym_i_pts_send_key(pane, TYM_KEY_DOWN); break;
+    case KEY_RIGHT: tym_i_pts_send_key(pane, TYM_KEY_RIGHT); break;
+    case KEY_LEFT : tym_i_pts_send_key(pane, TYM_KEY_LEFT); break;
+    case KEY_BACKSPACE: tym_i_pts_send_key(pane, TYM_KEY_BACKSPACE); break;
+    case KEY_HOME: tym_i_pts_send_key(pane, TYM_KEY_HOME); break;
+    case KEY_END: tym_i_pts_send_key(pane, TYM_KEY_END); break;
+    case KEY_DC: tym_i_pts_send_key(pane, TYM_KEY_DELETE); break;
+    default: tym_i_pts_send_key(pane, c); break;
   }
+  pthread_mutex_unlock(&pane->lock);
   return 0;
 }
 
@@ -146,6 +157,8 @@ static void initpad(struct tym_i_pane_internal* pane){
   struct curses_backend_pane* cbp = pane->backend;
   struct curses_screen_state* cscreen = &cbp->screen[pane->current_screen];
   if(!cscreen->window) return;
+  // The core scrolls its own grid, let curses turn scrolling of the pad into scrolling of the terminal where possible
+  idlok(cscreen->window, true);
 }
 
 static int pane_create(struct tym_i_pane_internal* pane){
@@ -370,6 +383,22 @@ static int pane_set_character(
   return 0;
 }
 
+static int pane_set_text_run(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t count, size_t length, const char utf8[length]
+){
+  (void)count;
+  struct curses_backend_pane* cbp = pane->backend;
+  struct curses_screen_state* cscreen = &cbp->screen[pane->current_screen];
+  if(!cscreen->window) return 0;
+  set_attribute(pane, format);
+  wmove(cscreen->window, position.y, position.x);
+  waddnstr(cscreen->window, utf8, length);
+  return 0;
+}
+
 static int resize(void){
   int scw = TYM_RECT_SIZE(tym_i_bounds, CHARFIELD, TYM_AXIS_HORIZONTAL);
   int sch = TYM_RECT_SIZE(tym_i_bounds, CHARFIELD, TYM_AXIS_VERTICAL);
@@ -408,5 +437,6 @@ TYM_I_BACKEND_REGISTER((
   .pane_set_cursor_position = pane_set_cursor_position,
   .pane_delete_characters = pane_delete_characters,
   .pane_set_character = pane_set_character,
+  .pane_set_text_run = pane_set_text_run,
   .update_terminal_size_information = update_terminal_size_information
 ))
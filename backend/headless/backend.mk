@@ -0,0 +1,8 @@
+BACKEND_SOURCES += src/main.c
+
+include src/common.mk
+
+all: build/backend/headless.a
+
+build/backend/headless.a: $(OBJS) | build/.dir
+	$(AR) scrT $@ $^
@@ -0,0 +1,262 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <internal/main.h>
+#include <internal/pane.h>
+#include <internal/screen.h>
+#include <internal/backend.h>
+
+/**
+ * \file
+ *
+ * A backend which doesn't display anything. Every pane gets a frame, which is
+ * an in-memory copy of what a real backend would be showing right now.
+ * The frames are updated from the grids of the core when a pane is rendered,
+ * all other drawing callbacks don't need to do anything.
+ *
+ * The size of the virtual screen can be set using the TM_HEADLESS_SIZE
+ * environment variable, for example TM_HEADLESS_SIZE=132x43. The default is 80x24.
+ */
+
+/** A cell of a frame */
+struct headless_cell {
+  char glyph[TYM_I_UTF8_CHARACTER_MAX_BYTE_COUNT];
+  struct tym_i_character_format format;
+};
+
+struct headless_backend_pane {
+  /** The size of the frame */
+  struct tym_i_cell_position size;
+  /** The content of the pane when it was rendered the last time */
+  struct headless_cell* frame;
+  struct tym_i_cell_position cursor;
+  enum tym_i_cursor_mode cursor_mode;
+};
+
+static struct tym_i_cell_position screen_size;
+
+static int init(struct tym_i_backend_capabilities* caps){
+  screen_size = (struct tym_i_cell_position){ .x = 80, .y = 24 };
+  const char* size = getenv("TM_HEADLESS_SIZE");
+  if(size){
+    unsigned w, h;
+    if(sscanf(size, "%ux%u", &w, &h) != 2 || !w || !h){
+      TYM_U_LOG(TYM_LOG_ERROR, "Invalid TM_HEADLESS_SIZE \"%s\"\n", size);
+      return -1;
+    }
+    screen_size = (struct tym_i_cell_position){ .x = w, .y = h };
+  }
+  caps->buffered = true;
+  caps->color_8 = true;
+  caps->color_256 = true;
+  caps->color_rgb = true;
+  return 0;
+}
+
+static int cleanup(bool zap){
+  (void)zap;
+  return 0;
+}
+
+static int resize(void){
+  return 0;
+}
+
+static int update_terminal_size_information(void){
+  TYM_POS_REF(tym_i_bounds.edge[TYM_RECT_BOTTOM_RIGHT], CHARFIELD, TYM_AXIS_HORIZONTAL) = screen_size.x;
+  TYM_POS_REF(tym_i_bounds.edge[TYM_RECT_BOTTOM_RIGHT], CHARFIELD, TYM_AXIS_VERTICAL) = screen_size.y;
+  return 0;
+}
+
+static int pane_create(struct tym_i_pane_internal* pane){
+  struct headless_backend_pane* hbp = calloc(1, sizeof(*hbp));
+  if(!hbp)
+    return -1;
+  pane->backend = hbp;
+  return 0;
+}
+
+static void pane_destroy(struct tym_i_pane_internal* pane){
+  struct headless_backend_pane* hbp = pane->backend;
+  if(!hbp)
+    return;
+  free(hbp->frame);
+  free(hbp);
+  pane->backend = 0;
+}
+
+/** Copy a part of a row of the current screen of the core into the frame */
+static void frame_update(struct tym_i_pane_internal* pane, unsigned y, unsigned start, unsigned end){
+  struct headless_backend_pane* hbp = pane->backend;
+  const struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
+  if(y >= hbp->size.y || y >= screen->grid.size.y)
+    return;
+  if(end > hbp->size.x)
+    end = hbp->size.x;
+  if(end > screen->grid.size.x)
+    end = screen->grid.size.x;
+  const struct tym_i_cell* line = tym_i_screen_line(screen, y);
+  struct headless_cell* frame = hbp->frame + (size_t)y * hbp->size.x;
+  for(unsigned x=start; x<end; x++){
+    memcpy(frame[x].glyph, line[x].glyph, sizeof(frame[x].glyph));
+    frame[x].format = *tym_i_style_get(pane, line[x].style);
+  }
+}
+
+static int pane_refresh(struct tym_i_pane_internal* pane){
+  struct headless_backend_pane* hbp = pane->backend;
+  for(unsigned y=0; y<hbp->size.y; y++)
+    frame_update(pane, y, 0, hbp->size.x);
+  return 0;
+}
+
+static int pane_render(struct tym_i_pane_internal* pane, size_t count, const struct tym_i_damage_span* span){
+  for(size_t i=0; i<count; i++)
+    frame_update(pane, span[i].y, span[i].start, span[i].end);
+  return 0;
+}
+
+static int pane_resize(struct tym_i_pane_internal* pane){
+  struct headless_backend_pane* hbp = pane->backend;
+  unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
+  unsigned h = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_VERTICAL);
+  if(hbp->size.x != w || hbp->size.y != h){
+    struct headless_cell* frame = 0;
+    if(w && h){
+      frame = calloc((size_t)w * h, sizeof(*frame));
+      if(!frame){
+        TYM_U_PERROR(TYM_LOG_ERROR, "calloc failed");
+        return -1;
+      }
+    }
+    free(hbp->frame);
+    hbp->frame = frame;
+    hbp->size = frame ? (struct tym_i_cell_position){ .x = w, .y = h } : (struct tym_i_cell_position){0};
+  }
+  return pane_refresh(pane);
+}
+
+static int pane_change_screen(struct tym_i_pane_internal* pane){
+  return pane_refresh(pane);
+}
+
+static int pane_set_cursor_position(struct tym_i_pane_internal* pane, struct tym_i_cell_position position){
+  struct headless_backend_pane* hbp = pane->backend;
+  hbp->cursor = position;
+  return 0;
+}
+
+static int pane_set_cursor_mode(struct tym_i_pane_internal* pane, enum tym_i_cursor_mode cursor_mode){
+  struct headless_backend_pane* hbp = pane->backend;
+  hbp->cursor_mode = cursor_mode;
+  return 0;
+}
+
+// The following changes are already in the grid of the core, they reach the frame in pane_render.
+
+static int pane_set_character(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t length, const char utf8[length+1],
+  bool insert
+){
+  (void)pane;
+  (void)position;
+  (void)format;
+  (void)utf8;
+  (void)insert;
+  return 0;
+}
+
+static int pane_set_text_run(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t count, size_t length, const char utf8[length]
+){
+  (void)pane;
+  (void)position;
+  (void)format;
+  (void)count;
+  (void)utf8;
+  return 0;
+}
+
+static int pane_set_area_to_character(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position start,
+  struct tym_i_cell_position end,
+  bool block,
+  struct tym_i_character_format format,
+  size_t length, const char utf8[length+1]
+){
+  (void)pane;
+  (void)start;
+  (void)end;
+  (void)block;
+  (void)format;
+  (void)utf8;
+  return 0;
+}
+
+static int pane_erase_area(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position start,
+  struct tym_i_cell_position end,
+  bool block,
+  struct tym_i_character_format format
+){
+  (void)pane;
+  (void)start;
+  (void)end;
+  (void)block;
+  (void)format;
+  return 0;
+}
+
+static int pane_delete_characters(struct tym_i_pane_internal* pane, struct tym_i_cell_position position, unsigned n){
+  (void)pane;
+  (void)position;
+  (void)n;
+  return 0;
+}
+
+static int pane_scroll(struct tym_i_pane_internal* pane, int n){
+  (void)pane;
+  (void)n;
+  return 0;
+}
+
+static int pane_scroll_region(struct tym_i_pane_internal* pane, int n, unsigned top, unsigned bottom){
+  (void)pane;
+  (void)n;
+  (void)top;
+  (void)bottom;
+  return 0;
+}
+
+TYM_I_BACKEND_REGISTER((
+  .init = init,
+  .cleanup = cleanup,
+  .resize = resize,
+  .pane_create = pane_create,
+  .pane_destroy = pane_destroy,
+  .pane_resize = pane_resize,
+  .pane_refresh = pane_refresh,
+  .pane_render = pane_render,
+  .pane_change_screen = pane_change_screen,
+  .pane_set_cursor_position = pane_set_cursor_position,
+  .pane_set_cursor_mode = pane_set_cursor_mode,
+  .pane_set_character = pane_set_character,
+  .pane_set_text_run = pane_set_text_run,
+  .pane_set_area_to_character = pane_set_area_to_character,
+  .pane_erase_area = pane_erase_area,
+  .pane_delete_characters = pane_delete_characters,
+  .pane_scroll = pane_scroll,
+  .pane_scroll_region = pane_scroll_region,
+  .update_terminal_size_information = update_terminal_size_information
+))
@@ -20,6 +20,7 @@ enum tym_i_cursor_mode {
 struct tym_i_pane_internal;
 struct tym_i_cell_position;
 struct tym_i_character_format;
+struct tym_i_damage_span;
 
 /**
  * Optional things the backend may support
@@ -39,7 +40,6 @@ struct tym_i_backend_capabilities {
   R(int, pane_create, (struct tym_i_pane_internal* pane), (Backend specific initialisation of pane. The variable is for pane->backend exclusive usage by the backend.)) \
   R(void, pane_destroy, (struct tym_i_pane_internal* pane), (Backend specific cleanup of panes.)) \
   R(int, pane_resize, (struct tym_i_pane_internal* pane), (Handle resizing & repositioning of panes.)) \
-  R(int, pane_scroll_region, (struct tym_i_pane_internal* pane, int n, unsigned top, unsigned bottom), (Scroll a region of the pane)) \
   R(int, pane_set_cursor_position, (struct tym_i_pane_internal* pane, struct tym_i_cell_position position), (Set the cursor position)) \
   R(int, pane_set_character, ( \
     struct tym_i_pane_internal* pane, \
@@ -48,14 +48,22 @@ struct tym_i_backend_capabilities {
     size_t length, const char utf8[length+1], \
     bool insert \
   ), (Set a character at the pecified position)) \
-  R(int, pane_delete_characters, \
-    (struct tym_i_pane_internal* pane, struct tym_i_cell_position position, unsigned n),  \
-    (Delete some characters of the pane and move the remaining ones to the left) \
-  ) \
   R(int, update_terminal_size_information, (void), (Sets #tym_i_bounds to the new size of the terminal. This is called from #tym_i_update_size_all, which shoud be called whenever the terminal/screen size changes. See #tym_i_update_size_all for all cases in which this happens automatically or should be done by the backend.)) \
   O(int, pane_refresh, (struct tym_i_pane_internal* pane), (Refresh/redraw pane)) \
+  O(int, pane_render, (struct tym_i_pane_internal* pane, size_t count, const struct tym_i_damage_span* span), (Render the parts of a pane which changed since it was rendered the last time. This is not called if nothing changed. The spans are ordered by row, and there is at most one per row. The current content is in the grid of the current screen. If the cursor moved, count may be 0.)) \
   O(int, pane_set_cursor_mode, (struct tym_i_pane_internal* pane, enum tym_i_cursor_mode cursor_mode), (Set the cursor mode. It can be a block, underlined, or invisible. )) \
-  O(int, pane_scroll, (struct tym_i_pane_internal* pane, int n), (Scroll the pane.)) \
+  O(int, pane_scroll_region, (struct tym_i_pane_internal* pane, int n, unsigned top, unsigned bottom), (Scroll a region of the pane. The core has already scrolled its grid, see tym_i_screen_scroll_region. This is only a hint which a backend can turn into a scroll of its output, the default redraws the region from the grid.)) \
+  O(int, pane_scroll, (struct tym_i_pane_internal* pane, int n), (Scroll the whole pane. Like pane_scroll_region, this is a hint.)) \
+  O(int, pane_set_text_run, ( \
+    struct tym_i_pane_internal* pane, \
+    struct tym_i_cell_position position, \
+    struct tym_i_character_format format, \
+    size_t count, size_t length, const char utf8[length] \
+  ), (Set count characters with the same format in a row, starting at the specified position. Each character takes up one cell. The characters are length bytes of utf8, which is not null terminated. A run never continues on the next row.)) \
+  O(int, pane_delete_characters, \
+    (struct tym_i_pane_internal* pane, struct tym_i_cell_position position, unsigned n),  \
+    (Delete some characters of the pane and move the remaining ones to the left) \
+  ) \
   O(int, pane_erase_area, ( \
     struct tym_i_pane_internal* pane, \
     struct tym_i_cell_position start, \
@@ -0,0 +1,30 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#ifndef TYM_INTERNAL_LOG_H
+#define TYM_INTERNAL_LOG_H
+
+/**
+ * \file
+ *
+ * Logging. Log messages aren't written by the thread logging them. Every thread has its own ring
+ * of log records, which only it writes to, without any locks or system calls. A background thread
+ * takes the records out of the rings, formats them and writes them to the debug file descriptor,
+ * a complete line at a time, so lines of different threads don't get mixed up.
+ * If the ring of a thread is full, its log messages are dropped and counted instead.
+ */
+
+enum {
+  /** The maximum length of a log message, longer ones are truncated */
+  TYM_I_LOG_MESSAGE_MAX = 200,
+  /** The number of log records a thread can have pending */
+  TYM_I_LOG_RING_SIZE = 128,
+  /** The maximum length of a line written to the debug file descriptor, longer ones are split */
+  TYM_I_LOG_LINE_MAX = 1024,
+};
+
+void tym_i_log_init(void);
+void tym_i_log_flush(void);
+int tym_i_log_fd(void);
+
+#endif
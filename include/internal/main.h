@@ -12,24 +12,13 @@
 
 /** \file */
 
+struct tym_i_pane_internal;
+
 struct tym_i_resize_handler_ptr_pair {
   void* ptr;
   tym_resize_handler_t callback;
 };
 
-/**
- * The main loop has an array of file descriptors to watch.
- * These are some special file descriptors the main loop is watching.
- * These constants are an offset in that list. All entries >= SPF_COUNT
- * are pseudo terminal master (ptm) file descriptors from panes.
- */
-enum tym_i_special_tym_i_poll_fds {
-  SPF_POLLCTLFD, //!< This file descriptor is used to add & remove new file descriptors.
-  SPF_SIGNALFD, //!< This file descriptor handles signals
-  SPF_TERMINPUT, //!< This file descriptor handles input from the underlying terminal
-  SPF_COUNT //!< The number of special file descriptors
-};
-
 /** The current run state */
 enum tym_i_init_state {
   INIT_STATE_NOINIT, //!< The library is not initialised or already shut down.
@@ -40,17 +29,34 @@ enum tym_i_init_state {
   INIT_STATE_SHUTDOWN = INIT_STATE_NOINIT //!< The library is not initialised or already shut down
 };
 
+enum {
+  /** The number of frames per second rendered by default, see tym_set_render_rate */
+  TYM_I_DEFAULT_RENDER_RATE = 60,
+  /** Reads of up to this many bytes are rendered immediately if no frame was rendered recently */
+  TYM_I_RENDER_IMMEDIATE_MAX = 32,
+  /** The maximum number of bytes read from a pseudo terminal master at once */
+  TYM_I_READ_SIZE = 4096,
+  /** The number of bytes a pane may read every time it's its turn by default, see tym_set_read_budget */
+  TYM_I_DEFAULT_READ_QUANTUM = TYM_I_READ_SIZE,
+  /** The number of bytes of unused budget a pane can save up by default, see tym_set_read_budget */
+  TYM_I_DEFAULT_READ_BUDGET_MAX = 4 * TYM_I_READ_SIZE,
+  /** The number of bytes a pane may read before its output is rendered by default, see tym_set_unrendered_limit */
+  TYM_I_DEFAULT_UNRENDERED_LIMIT = 1024 * 1024,
+  /** The number of bytes which may be queued for sending to a pane by default, see tym_set_send_queue_limit */
+  TYM_I_DEFAULT_SEND_QUEUE_LIMIT = 256 * 1024,
+  /** The maximum number of bytes of a control string passed to its handler at once by default, see tym_set_string_chunk_size */
+  TYM_I_DEFAULT_STRING_CHUNK_SIZE = TYM_I_READ_SIZE
+};
+
 /** Some action for the main loop to do */
 enum tym_i_poll_ctl_type {
-  TYM_PC_ADD, //!< Add a file dexcriptor
-  TYM_PC_REMOVE, //!< remove a file descriptor
   TYM_PC_FREEZE, //!< exit main loop temporarely
+  TYM_PC_SEND_QUEUED, //!< data is queued for sending to a pane, watch its master until it can be written
 };
 
 /**
- * Additional information for entries in tym_i_poll_list.
- * tym_i_poll_list is an array of struct pollfd, which is needed by poll and thus can't be modified.
- * This is why extra data is stored using this structure in tym_i_poll_list_complement in a 1:1 mapping.
+ * Additional information for file descriptors watched by the main loop.
+ * One of these is stored in the tym_i_pollfd_entry of every watched file descriptor.
  */
 struct tym_i_pollfd_complement {
   /** A user defined pointer supplied to the callback function */
@@ -59,49 +65,110 @@ struct tym_i_pollfd_complement {
   int(*onevent)(void* ptr, short event, int fd);
   /** A callback function which is called if the file descriptor is removed from the ones to be polled. */
   int(*onremove)(void* ptr, int fd);
+  /**
+   * Only report new events instead of the current readiness of the file descriptor (EPOLLET).
+   * If this is set, onevent has to read or write until the file descriptor would block,
+   * otherwise it won't be called again.
+   */
+  bool edge_triggered;
+  /**
+   * Stop watching the file descriptor after an event was reported (EPOLLONESHOT),
+   * until tym_i_pollfd_rearm is called. This is used to hand the file descriptor to another thread.
+   */
+  bool oneshot;
+};
+
+/**
+ * A file descriptor watched by the main loop.
+ * These are stored in tym_i_pollfd_table, using the file descriptor as index.
+ */
+struct tym_i_pollfd_entry {
+  /** The watched file descriptor */
+  int fd;
+  /**
+   * Incremented every time a file descriptor is added.
+   * It's stored together with the file descriptor in the epoll event data,
+   * this way, events of file descriptors which have been removed or replaced
+   * while other events of the same epoll_wait call were being handled can be detected and ignored.
+   */
+  uint32_t generation;
+  /** The epoll events currently watched for */
+  uint32_t events;
+  /** Set while the file descriptor isn't watched, see tym_i_pollfd_pause */
+  bool paused;
+  /**
+   * Set once an event of a file descriptor with tym_i_pollfd_complement::oneshot set was reported,
+   * until tym_i_pollfd_rearm is called. The file descriptor isn't watched in the meantime.
+   */
+  bool disarmed;
+  /** The callbacks & the user defined pointer */
+  struct tym_i_pollfd_complement complement;
 };
 
 /** A structure containing a command & parameters for the main loop */
 struct tym_i_poll_ctl {
-  /** Some action for the main loop to do. Also determines the union member of data to be used. */
+  /** Some action for the main loop to do. */
   enum tym_i_poll_ctl_type action;
-  /** data for the action */
-  union {
-    struct {
-      int fd;
-      struct tym_i_pollfd_complement complement;
-    } add;
-    struct {
-      int fd;
-    } remove;
-  } data;
+  /** The id of the pane, for TYM_PC_SEND_QUEUED */
+  int pane;
 };
 
 /** The current run state */
 extern enum tym_i_init_state tym_i_binit;
 /** The number of file descripors watched by the main loop. */
 extern size_t tym_i_poll_count;
-/** The poll descriptor list. */
-extern struct pollfd* tym_i_poll_list;
+/** The epoll file descriptor the main loop waits on. */
+extern int tym_i_epoll_fd;
+/** The size of tym_i_pollfd_table */
+extern size_t tym_i_pollfd_table_size;
 /**
- * Additional informations for each entry in tym_i_poll_list.
- * This list should have the same length.
- * \see tym_i_pollfd_complement
+ * All file descriptors watched by the main loop, indexed by the file descriptor.
+ * Unused entries are null pointers.
+ * \see tym_i_pollfd_entry
  */
-extern struct tym_i_pollfd_complement* tym_i_poll_list_complement;
+extern struct tym_i_pollfd_entry** tym_i_pollfd_table;
 /** The a file descriptors for sending commands to the main loop */
 extern int tym_i_cmd_fd;
 /** The thread of the main loop */
 extern pthread_t tym_i_main_loop;
 /** The size of the screen. */
 extern struct tym_absolute_position_rectangle tym_i_bounds;
-/** Attributes for tym_i_lock */
+/** Incremented every time tym_i_bounds changes. Protected by tym_i_lock. \see tym_i_pane_internal::bounds_generation */
+extern unsigned tym_i_bounds_generation;
+/** Attributes for tym_i_lock, tym_i_backend_lock and tym_i_pane_internal::lock */
 extern pthread_mutexattr_t tym_i_lock_attr;
 /**
- * The lock which makes sure only one thread at a time can access any of the tym_i_* functions.
- * This is a reentrant mutex.
+ * The lock for everything which isn't specific to a single pane, like the list of panes,
+ * the pane in focus, the file descriptors watched by the main loop and the run state.
+ * The state of a pane is protected by the lock of the pane, see tym_i_pane_internal::lock.
+ *
+ * The locks must be taken in this order: tym_i_lock, the lock of a pane, tym_i_backend_lock.
+ * While the lock of a pane is held, tym_i_lock mustn't be taken, unless it's already held,
+ * and no other pane may be locked. This is a reentrant mutex.
  */
 extern pthread_mutex_t tym_i_lock;
+/**
+ * Calls into the backend are serialised using this lock. It's always the last lock taken.
+ * This is a reentrant mutex.
+ */
+extern pthread_mutex_t tym_i_backend_lock;
+
+/** The minimum time between two frames in nanoseconds, or 0 to render after every read. \see tym_set_render_rate */
+extern long tym_i_render_interval;
+/** The timerfd used to pace rendering, see tym_i_render_schedule */
+extern int tym_i_render_timer_fd;
+/** The number of bytes added to the budget of a pane every time it's read. This can only be changed while the library isn't initialised. \see tym_i_pane_read */
+extern size_t tym_i_read_quantum;
+/** The maximum budget of a pane. \see tym_i_pane_read */
+extern size_t tym_i_read_budget_max;
+/** The number of bytes a pane may read before its output has to be rendered, or 0. \see tym_i_pane_flow_control */
+extern size_t tym_i_unrendered_limit;
+/** The number of bytes which may be queued for sending to a pane. This can only be changed while the library isn't initialised. \see tym_i_pts_send */
+extern size_t tym_i_send_queue_limit;
+/** What to do with data sent to a pane if its queue is full. This can only be changed while the library isn't initialised. */
+extern enum tym_send_overflow tym_i_send_overflow;
+/** The maximum number of bytes of a control string passed to its handler at once. This can only be changed while the library isn't initialised. */
+extern size_t tym_i_string_chunk_size;
 
 /** The number of resize handlers in #tym_i_resize_handler_list. */
 extern size_t tym_i_resize_handler_count;
@@ -116,11 +183,18 @@ void tym_i_finalize_cleanup(bool zap);
 int tym_i_update_size_all(void);
 int tym_i_pollfd_add(int fd, const struct tym_i_pollfd_complement* pcm);
 int tym_i_pollfd_remove(int fd);
+int tym_i_pollfd_rearm(int fd);
+int tym_i_pollfd_pause(int fd, bool pause);
+int tym_i_pollfd_watch_output(int fd, bool watch);
 int tym_i_resize_handler_add(const struct tym_i_resize_handler_ptr_pair* cp);
 int tym_i_resize_handler_remove(size_t entry);
 int tym_i_request_freeze(void);
+int tym_i_request_send_queue_flush(int pane);
+void tym_i_render_schedule(struct tym_i_pane_internal* pane, size_t size);
 
 int tym_i_pollhandler_ctl_command_handler(void* ptr, short event, int fd);
 int tym_i_pollhandler_signal_handler(void* ptr, short event, int fd);
+int tym_i_pollhandler_render_timer(void* ptr, short event, int fd);
+int tym_i_pollhandler_render_timer_remove(void* ptr, int fd);
 
 #endif
@@ -7,12 +7,15 @@
 /** \file */
 
 #include <poll.h>
+#include <pthread.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <termios.h>
 #include <internal/utf8.h>
 #include <internal/charset.h>
+#include <internal/trace.h>
 #include <libttymultiplex.h>
 #include <sys/types.h>
 
@@ -29,34 +32,56 @@ enum tym_i_pane_screen {
 };
 
 enum {
-  /** The longest escape sequence libttymultiplex allows for */
-  TYM_I_MAX_SEQ_LEN = 256,
   /** How many integers are allowed in an escape sequence. */
   TYM_I_MAX_INT_COUNT = 12,
+  /** How many intermediate characters are allowed in an escape sequence. */
+  TYM_I_MAX_INTERMEDIATE_COUNT = 2,
+  /** The maximum length of the title of a pane in bytes, longer titles are truncated. */
+  TYM_I_MAX_TITLE_LENGTH = 4096,
 };
 
+/**
+ * The states of the escape sequence parser.
+ * These are the states of the parser described in ECMA-48 and used by DEC terminals.
+ * See the transition table in parser.c.
+ */
+enum tym_i_parser_state {
+  TYM_I_PS_GROUND, //!< Not in an escape sequence, characters are printed
+  TYM_I_PS_ESCAPE, //!< An ESC was encountered
+  TYM_I_PS_ESCAPE_INTERMEDIATE, //!< An ESC followed by intermediate characters
+  TYM_I_PS_ESCAPE_CHARACTER, //!< An escape sequence which takes the next character as argument, like SS2
+  TYM_I_PS_CSI_ENTRY, //!< A control sequence introducer (CSI) was encountered
+  TYM_I_PS_CSI_PARAM, //!< Parsing the parameters of a control sequence
+  TYM_I_PS_CSI_INTERMEDIATE, //!< Parsing the intermediate characters of a control sequence
+  TYM_I_PS_CSI_IGNORE, //!< A malformed control sequence, ignore everything until its final character
+  TYM_I_PS_OSC_STRING, //!< The string of an operating system command (OSC)
+  TYM_I_PS_STRING, //!< A DCS, SOS, PM or APC string
+  TYM_I_PARSER_STATE_COUNT
+};
+
+struct tym_i_command_sequence;
+
 /** The state of the escape sequence parser */
 struct tym_i_sequence_state {
-  /** The number of characters in buffer, which may be part of an escape sequence */
-  unsigned short length;
-  /** The offset into the escape sequence template for comparing the next character against */
-  unsigned short index;
-  /**
-   * See specialmatch() in parser.c.
-   * This is for multi character elements of the escape sequence template, such as numbers, for example.
-   * Indicates that the last match was such an element.
-   */
-  bool last_special_match_continue;
-  /** The buffer containing the sequence currently being parsed. */
-  char buffer[TYM_I_MAX_SEQ_LEN];
+  /** The current state of the parser, see #tym_i_parser_state */
+  unsigned char state;
+  /** The private marker of a control sequence (one of '<', '=', '>', '?'), or 0 */
+  char private_marker;
+  /** The number of intermediate characters in intermediate */
+  unsigned char intermediate_count;
+  /** The intermediate characters of the escape sequence */
+  char intermediate[TYM_I_MAX_INTERMEDIATE_COUNT];
+  /** Set once the start of a control string was passed to its handler, see tym_i_csq_string_callback */
+  bool string_started;
   /** The number of integer arguments of the escape sequence which have been parsed. */
   unsigned integer_count;
   /** The integer arguments contained in the escape sequence. */
   int integer[TYM_I_MAX_INT_COUNT];
-  /** The escape sequence templates are sorted. This is the first sequence which could still match. */
-  ssize_t seq_opt_min;
-  /** The escape sequence templates are sorted. This is the last sequence which could still match. */
-  ssize_t seq_opt_max;
+  /**
+   * An escape sequence still waiting for the character it takes as argument, see TYM_I_PS_ESCAPE_CHARACTER,
+   * or the escape sequence of the current control string, see TYM_I_PS_OSC_STRING & TYM_I_PS_STRING.
+   */
+  const struct tym_i_command_sequence* command;
 };
 
 enum { TYM_I_G_CHARSET_COUNT=4 };
@@ -120,6 +145,7 @@ enum tym_i_decset_decres {
   TYM_I_DSDR_MOUSE_MODE_ANY = 1003,
   TYM_I_DSDR_ALTERNATE_SCREEN_2 = 1047,
   TYM_I_DSDR_ALTERNATE_SCREEN_3 = 1049,
+  TYM_I_DSDR_BRACKETED_PASTE = 2004,
 };
 
 struct tym_i_termcolor {
@@ -178,6 +204,80 @@ struct tym_i_character {
   union tym_i_character_data data;
 };
 
+/** A cell of the screen grid */
+struct tym_i_cell {
+  /** The utf-8 sequence of the character in the cell. Unused bytes are 0, an erased cell has no character at all. */
+  char glyph[TYM_I_UTF8_CHARACTER_MAX_BYTE_COUNT];
+  /** The character format of the cell, an index into tym_i_pane_internal::style. \see tym_i_style_intern */
+  uint16_t style;
+};
+
+/**
+ * The content of a screen of a pane. The cells are stored in a single array, row by row.
+ * The rows aren't in order, the order is kept in a ring of row indices instead,
+ * which allows scrolling without moving any cells. Use tym_i_screen_line to access a row.
+ * The size of the grid follows the size of the pane, see tym_i_screen_resize.
+ */
+struct tym_i_cell_grid {
+  /** The number of columns and rows of the grid */
+  struct tym_i_cell_position size;
+  /** The cells of the grid, size.x * size.y of them */
+  struct tym_i_cell* cell;
+  /** The index of the row in tym_i_cell_grid::cell for each line, starting at line tym_i_cell_grid::first */
+  unsigned* row;
+  /** The entry of tym_i_cell_grid::row which contains the first line */
+  unsigned first;
+};
+
+/**
+ * All character formats used by the cells of a pane. Each distinct format is only stored once.
+ * The format with index 0 is always tym_i_default_character_format.
+ */
+struct tym_i_style_table {
+  /** The number of character formats in the table */
+  size_t count;
+  /** The number of character formats there is space for */
+  size_t capacity;
+  /** The character formats */
+  struct tym_i_character_format* format;
+  /** A hash table for looking up formats, with 2 * capacity entries. Each entry is an index into format plus 1, or 0 if unused. */
+  uint32_t* index;
+  /** The value of tym_i_pane_stats::cells_written when the unused formats were removed the last time */
+  uint64_t collected;
+};
+
+/** A part of a row of a pane which changed, from column start up to but excluding column end */
+struct tym_i_damage_span {
+  unsigned y, start, end;
+};
+
+/**
+ * The parts of a pane which changed since it was last rendered.
+ * \see tym_i_damage_mark tym_i_pane_render
+ */
+struct tym_i_damage {
+  /** The number of rows which can be tracked */
+  unsigned rows;
+  /** A bitset of rows which changed */
+  uint64_t* row;
+  /** The changed columns of each changed row */
+  struct tym_i_damage_span* span;
+  /** Was any row marked as changed? */
+  bool any;
+  /** Did the cursor move? */
+  bool cursor;
+  /** Set if regions were scrolled which can't be passed to the backend as a single scroll, \see tym_i_damage_scroll */
+  bool scroll_lost;
+  /** The number of rows the scrolled region moved up (n>0) or down (n<0) since the last render */
+  int scroll;
+  /** The top of the scrolled region */
+  unsigned scroll_top;
+  /** The bottom of the scrolled region */
+  unsigned scroll_bottom;
+  /** The cursor position last passed to the backend */
+  struct tym_i_cell_position cursor_position;
+};
+
 /**
  * These are pane states which apply on a per-screen basis rather than a per-pane basis.
  * \see tym_i_pane_internal::screen
@@ -204,6 +304,54 @@ struct tym_i_pane_screen_state {
   bool origin_mode : 1;
   /** Indicates wheter at one character after the end of a line, after a character is input, the cursor should not be put on the next line before writing it. */
   bool wraparound_mode_off : 1;
+  /** The content of the screen */
+  struct tym_i_cell_grid grid;
+};
+
+/** Data which couldn't be written to the pseudo terminal master of a pane yet. \see tym_i_pts_send */
+struct tym_i_send_queue {
+  /** The buffer, or a null pointer if nothing was ever queued */
+  char* data;
+  /** The offset of the first byte which wasn't written yet */
+  size_t offset;
+  /** The number of bytes which weren't written yet */
+  size_t size;
+  /** The size of the buffer */
+  size_t capacity;
+};
+
+/**
+ * Text which is being pasted into a pane, but wasn't passed to tym_i_pts_send yet.
+ * It's passed on in chunks as the queue of the pane drains. \see tym_i_pts_paste
+ */
+struct tym_i_paste {
+  /** The text, or a null pointer if nothing is being pasted */
+  const char* text;
+  /** The copy of the text owned by the pane, if any. text points into it. */
+  char* buffer;
+  /** The offset of the first byte of text which wasn't passed on yet */
+  size_t offset;
+  /** The number of bytes of text which weren't passed on yet */
+  size_t size;
+  /** Set if the text has to be followed by the end marker of bracketed paste mode */
+  bool bracketed;
+  /** Set if the last byte passed on was a carriage return */
+  bool cr;
+};
+
+/** Counters of what a pane did, see tym_pane_get_stats */
+struct tym_i_pane_stats {
+  uint64_t bytes_read;
+  uint64_t reads;
+  uint64_t sequences_unknown;
+  uint64_t utf8_invalid;
+  uint64_t scrolls;
+  uint64_t cells_written;
+  uint64_t refreshes;
+  /** In nanoseconds */
+  uint64_t parse_time;
+  /** How often every entry of the escape sequence table was handled, see tym_i_command_sequence_map_count */
+  uint64_t* sequence;
 };
 
 /** Internal variables of a pane */
@@ -218,12 +366,45 @@ struct tym_i_pane_internal {
    * The pane in focus doesn't have the id 1 though, the id never changes
    */
   int id;
+  /**
+   * Protects the state of the pane, including its screens, parser state and the pseudo terminal master.
+   * This is a reentrant mutex. See tym_i_lock for the order in which locks have to be taken.
+   */
+  pthread_mutex_t lock;
+  /**
+   * The number of references to the pane. The list of panes holds one, tym_i_pane_acquire another one.
+   * This is protected by tym_i_lock. The pane is freed once there are none left.
+   */
+  unsigned refcount;
+  /** Set by tym_pane_destroy. A pane may still be referenced after it was destroyed, but mustn't be used anymore. */
+  bool destroyed;
+  /** The number of bytes the pane may still read, protected by the lock of the pane. \see tym_i_pane_read */
+  size_t budget;
+  /**
+   * The number of bytes read since the pane was rendered the last time, protected by the lock of the pane.
+   * \see tym_i_pane_flow_control
+   */
+  size_t unrendered;
+  /** Set while the master isn't watched because of too much unrendered output, protected by tym_i_lock. */
+  bool throttled;
+  /** The time spent on the pane in every phase, protected by the lock of the pane. \see tym_trace_dump */
+  struct tym_i_trace_stats trace[TYM_I_TRACE_PHASE_COUNT];
+  /** Counters of what the pane did, protected by the lock of the pane */
+  struct tym_i_pane_stats stats;
+  /** The next pane in the queue of the workers, protected by the lock of the queue. \see tym_i_worker_enqueue */
+  struct tym_i_pane_internal* worker_next;
   /** The pseudo terminal master (PTM) file descriptor */
   int master;
   /** The pseudo terminal slave (PTS) file descriptor */
   int slave;
+  /** The data which is still to be written to the master, protected by the lock of the pane */
+  struct tym_i_send_queue send_queue;
+  /** The text which is still to be pasted, protected by the lock of the pane */
+  struct tym_i_paste paste;
   /** A flag indicating if fetting the focus on this pane is disallowed */
   bool nofocus;
+  /** Set if this is tym_i_focus_pane. This is protected by the lock of the pane, so it can be checked while parsing. */
+  bool focus;
   /** A private variable reserved for usage by the backend */
   void* backend;
   /** The current state of the escape sequence parser. */
@@ -234,6 +415,8 @@ struct tym_i_pane_internal {
   struct tym_super_position_rectangle super_position;
   /** The computed position of the pane */
   struct tym_absolute_position_rectangle absolute_position;
+  /** The tym_i_bounds_generation absolute_position was computed for */
+  unsigned bounds_generation;
   /** The number of registred resize handlers */
   size_t resize_handler_count;
   /** A list of registred resize handlers */
@@ -248,8 +431,20 @@ struct tym_i_pane_internal {
   enum tym_button last_button;
   /** The current mouse mode. Specifies what kind of mouse events are sent and how. */
   enum tym_i_mouse_mode mouse_mode;
+  /** Set if pasted text has to be enclosed in escape sequences. \see tym_i_pts_paste */
+  bool bracketed_paste;
+  /** The title set by the program in the pane, null terminated, or a null pointer. \see tym_pane_get_title */
+  char* title;
+  /** The title which is currently being received, it isn't null terminated. \see tym_i_csq_osc_cmd_string */
+  char* title_pending;
+  /** The length of title_pending */
+  size_t title_pending_length;
   /** The last character printed to the pane */
   struct tym_i_character last_character;
+  /** The character formats used by the cells of the screens of the pane */
+  struct tym_i_style_table style;
+  /** The parts of the pane which have to be rendered */
+  struct tym_i_damage damage;
 
   /** These are states which apply on a per-screen basis rather than a per-pane basis. */
   struct tym_i_pane_screen_state screen[TYM_I_SCREEN_COUNT];
@@ -259,7 +454,7 @@ struct tym_i_pane_internal {
 extern struct tym_i_pane_internal *tym_i_pane_list_start;
 /** The last pane of the doubly linked list of panes */
 extern struct tym_i_pane_internal *tym_i_pane_list_end;
-/** The pane currently in focus. May be 0. */
+/** The pane currently in focus. May be 0. \see tym_i_pane_internal::focus */
 extern struct tym_i_pane_internal *tym_i_focus_pane;
 /** This is the default format. It's all zero. It has no special formatting, uses the terminals default colors, and so on. */
 extern const struct tym_i_character_format tym_i_default_character_format;
@@ -270,6 +465,11 @@ int tym_i_pane_resize_handler_add(struct tym_i_pane_internal* pane, const struct
 int tym_i_pane_resize_handler_remove(struct tym_i_pane_internal* pane, size_t entry);
 void tym_i_pane_add(struct tym_i_pane_internal* pane);
 struct tym_i_pane_internal* tym_i_pane_get(int pane);
+struct tym_i_pane_internal* tym_i_pane_acquire(int pane);
+void tym_i_pane_release(struct tym_i_pane_internal* pane);
+void tym_i_pane_unref(struct tym_i_pane_internal* pane);
+ssize_t tym_i_pane_read(struct tym_i_pane_internal* pane);
+void tym_i_pane_flow_control(struct tym_i_pane_internal* pane);
 void tym_i_pane_remove(struct tym_i_pane_internal* pane);
 int tym_i_pane_focus(struct tym_i_pane_internal* pane);
 void tym_i_pane_update_cursor(struct tym_i_pane_internal* pane);
@@ -4,6 +4,7 @@
 #ifndef TYM_INTERNAL_PARSER_H
 #define TYM_INTERNAL_PARSER_H
 
+#include <stddef.h>
 #include <internal/charset.h>
 
 /** \file */
@@ -41,6 +42,25 @@ struct tym_i_pane_internal;
  */
 typedef int (*tym_i_csq_sequence_callback)(struct tym_i_pane_internal* pane);
 
+/** What happened to a control string (OSC, DCS, SOS, PM or APC), see tym_i_csq_string_callback */
+enum tym_i_string_event {
+  /** The string started. For OSC strings, this is after the command number, which is in integer[0]. */
+  TYM_I_STRING_START,
+  /** A part of the content of the string */
+  TYM_I_STRING_DATA,
+  /** The string was aborted by CAN or SUB, the callback of the escape sequence won't be called */
+  TYM_I_STRING_ABORT,
+};
+
+/**
+ * This is the type of the callback functions which get the content of control strings as it's parsed.
+ * The content isn't buffered, it's passed on in parts of at most tym_i_string_chunk_size bytes,
+ * taken from the output of the pane as is. A handler which needs the whole string has to collect it.
+ * Once the string is terminated, the tym_i_csq_sequence_callback of the escape sequence is called as usual.
+ * For TYM_I_STRING_START and TYM_I_STRING_ABORT, size is 0.
+ */
+typedef void (*tym_i_csq_string_callback)(struct tym_i_pane_internal* pane, enum tym_i_string_event event, size_t size, const char data[size]);
+
 /**
  * This is the mapping between escape sequences, their description/name and their callback function.
  */
@@ -53,8 +73,13 @@ struct tym_i_command_sequence {
   const char* callback_name;
   /** A pointer to the callback function */
   tym_i_csq_sequence_callback callback;
+  /** A pointer to the function getting the content of a control string, see tym_i_csq_string_callback */
+  tym_i_csq_string_callback string_callback;
 };
 
+/** The number of entries in the table of escape sequences. \see tym_i_pane_stats::sequence */
+extern const size_t tym_i_command_sequence_map_count;
+
 /**
  * This is just a hook for some white box tests to check if an escape sequence
  * was detected
@@ -75,6 +100,13 @@ extern void tym_i_nocsq_test_hook(const struct tym_i_pane_internal* pane, char c
  */
 void tym_i_pane_parse(struct tym_i_pane_internal* pane, unsigned char c);
 
+/**
+ * Parse a buffer of characters read from the pseudo terminal master of a pane.
+ * This has the same effect as passing each character to tym_i_pane_parse,
+ * but printable characters outside of escape sequences are handled in bulk.
+ */
+void tym_i_pane_parse_buffer(struct tym_i_pane_internal* pane, const char* buffer, size_t length);
+
 int tym_i_invoke_charset(struct tym_i_pane_internal* pane, enum charset_selection cs);
 
 #endif
@@ -0,0 +1,43 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#ifndef TYM_INTERNAL_PROFILE_H
+#define TYM_INTERNAL_PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <internal/trace.h>
+
+/**
+ * \file
+ *
+ * Profiling of the escape sequence handlers, see tym_set_profiling & tym_profile_dump.
+ * For every entry of the escape sequence table, the calls of its handler are counted,
+ * and the time they took is added to a histogram. The buckets of the histogram are
+ * log-linear, like those of an HDR histogram: every power of two is split into
+ * TYM_I_PROFILE_SUB_BUCKET_COUNT buckets of equal size.
+ */
+
+enum {
+  /** The number of bits of a duration below its most significant one which determine its bucket */
+  TYM_I_PROFILE_SUB_BUCKET_BITS = 2,
+  /** The number of buckets every power of two is split into */
+  TYM_I_PROFILE_SUB_BUCKET_COUNT = 1 << TYM_I_PROFILE_SUB_BUCKET_BITS,
+  /** The number of buckets, durations of 2^32ns or more end up in the last one */
+  TYM_I_PROFILE_BUCKET_COUNT = (32 - TYM_I_PROFILE_SUB_BUCKET_BITS + 1) * TYM_I_PROFILE_SUB_BUCKET_COUNT,
+};
+
+/** Set while profiling is enabled, accessed atomically */
+extern bool tym_i_profile_enabled;
+
+void tym_i_profile_end(size_t index, uint64_t start);
+
+/** Start timing an escape sequence handler. Returns its start time, or 0 if profiling is disabled. */
+static inline uint64_t tym_i_profile_begin(void){
+  if(!__atomic_load_n(&tym_i_profile_enabled, __ATOMIC_RELAXED))
+    return 0;
+  return tym_i_trace_now();
+}
+
+#endif
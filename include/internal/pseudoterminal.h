@@ -9,9 +9,12 @@
 #include <internal/pane.h>
 
 int tym_i_pts_send(struct tym_i_pane_internal* pane, size_t size, const void*restrict data);
+int tym_i_pts_flush(struct tym_i_pane_internal* pane);
+void tym_i_pts_discard(struct tym_i_pane_internal* pane);
 int tym_i_pts_send_key(struct tym_i_pane_internal* pane, uint_least16_t key);
 int tym_i_pts_send_keys(struct tym_i_pane_internal* pane, size_t count, const uint_least16_t keys[count]);
 int tym_i_pts_type(struct tym_i_pane_internal* pane, size_t count, const char keys[count]);
+int tym_i_pts_paste(struct tym_i_pane_internal* pane, size_t size, const char data[size]);
 int tym_i_pts_send_mouse_event(struct tym_i_pane_internal* pane, enum tym_button button, struct tym_i_cell_position pos);
 
 #endif
@@ -0,0 +1,22 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#ifndef TYM_INTERNAL_SCAN_H
+#define TYM_INTERNAL_SCAN_H
+
+#include <stddef.h>
+
+/** \file */
+
+/**
+ * Get the number of printable ascii characters (0x20-0x7E) at the start of a buffer.
+ * Depending on what the CPU supports, this uses SSE2 or AVX2 instructions.
+ * The implementation is selected once when the library is loaded.
+ *
+ * \param length The size of the buffer
+ * \param data The buffer to be scanned
+ * \returns The length of the run of printable ascii characters at the start of the buffer
+ */
+extern size_t (*tym_i_scan_printable_ascii)(size_t length, const unsigned char data[length]);
+
+#endif
@@ -0,0 +1,82 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#ifndef TYM_INTERNAL_SCREEN_H
+#define TYM_INTERNAL_SCREEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <internal/pane.h>
+
+/**
+ * \file
+ *
+ * The core keeps the content of every screen of every pane in a grid of cells,
+ * see tym_i_cell_grid. The functions in this file change the content of the grid
+ * and pass the change on to the backend. Sequence handlers should always use these
+ * instead of calling the backend directly, backends can rely on the grid
+ * being up to date when rendering. If there are workers, the changes are only
+ * passed on when the pane is rendered, see internal/worker.h.
+ */
+
+/** Don't use more than this many different character formats per pane */
+#define TYM_I_STYLE_MAX 0x10000
+/** The number of cells which have to be written before unused character formats are looked for again */
+#define TYM_I_STYLE_COLLECT_INTERVAL 4096
+
+/** Get the entry of the row ring of a grid which belongs to a line */
+static inline unsigned* tym_i_screen_ring_entry(const struct tym_i_cell_grid* grid, unsigned y){
+  unsigned i = grid->first + y;
+  return &grid->row[i < grid->size.y ? i : i - grid->size.y];
+}
+
+/** Get a row of the grid of a screen */
+static inline struct tym_i_cell* tym_i_screen_line(const struct tym_i_pane_screen_state* screen, unsigned y){
+  return screen->grid.cell + (size_t)*tym_i_screen_ring_entry(&screen->grid, y) * screen->grid.size.x;
+}
+
+uint16_t tym_i_style_intern(struct tym_i_pane_internal* pane, const struct tym_i_character_format* format);
+const struct tym_i_character_format* tym_i_style_get(const struct tym_i_pane_internal* pane, uint16_t style);
+
+int tym_i_screen_resize(struct tym_i_pane_internal* pane);
+void tym_i_screen_free(struct tym_i_pane_internal* pane);
+void tym_i_screen_scroll_region(struct tym_i_pane_internal* pane, int n, unsigned top, unsigned bottom);
+int tym_i_screen_draw(struct tym_i_pane_internal* pane, unsigned y, unsigned start, unsigned end);
+
+void tym_i_damage_mark(struct tym_i_pane_internal* pane, unsigned y, unsigned start, unsigned end);
+void tym_i_damage_mark_all(struct tym_i_pane_internal* pane);
+void tym_i_damage_scroll(struct tym_i_pane_internal* pane, int n, unsigned top, unsigned bottom);
+int tym_i_pane_render(struct tym_i_pane_internal* pane);
+
+int tym_i_pane_set_character(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t length, const char utf8[length+1],
+  bool insert
+);
+int tym_i_pane_set_text_run(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t count, size_t length, const char utf8[length]
+);
+int tym_i_pane_set_area_to_character(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position start,
+  struct tym_i_cell_position end,
+  bool block,
+  struct tym_i_character_format format,
+  size_t length, const char utf8[length+1]
+);
+int tym_i_pane_erase_area(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position start,
+  struct tym_i_cell_position end,
+  bool block,
+  struct tym_i_character_format format
+);
+int tym_i_pane_delete_characters(struct tym_i_pane_internal* pane, struct tym_i_cell_position position, unsigned n);
+
+#endif
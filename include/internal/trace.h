@@ -0,0 +1,64 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#ifndef TYM_INTERNAL_TRACE_H
+#define TYM_INTERNAL_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * \file
+ *
+ * Timing of the stages output goes through, see tym_set_tracing & tym_trace_dump.
+ * A span is started with tym_i_trace_begin and ended with tym_i_trace_end. The time spent
+ * in every phase is summed up per pane, and the most recent spans are kept for tym_trace_dump.
+ * While tracing is disabled, tym_i_trace_begin returns 0 and tym_i_trace_end does nothing.
+ */
+
+struct tym_i_pane_internal;
+
+#define TYM_I_TRACE_PHASE_LIST(X) \
+  X(DISPATCH, dispatch) \
+  X(READ, read) \
+  X(PARSE, parse) \
+  X(SEQUENCE, sequence) \
+  X(RENDER, render)
+
+/** The things which are timed */
+enum tym_i_trace_phase {
+#define X(ID, NAME) TYM_I_TRACE_ ## ID,
+  TYM_I_TRACE_PHASE_LIST(X)
+#undef X
+  TYM_I_TRACE_PHASE_COUNT
+};
+
+/** The spans of a phase, summed up */
+struct tym_i_trace_stats {
+  /** The number of spans */
+  uint64_t count;
+  /** The total duration of the spans in nanoseconds */
+  uint64_t total;
+  /** The duration of the longest span in nanoseconds */
+  uint64_t max;
+};
+
+enum {
+  /** The number of spans kept for tym_trace_dump, older ones are overwritten */
+  TYM_I_TRACE_EVENT_MAX = 8192
+};
+
+/** Set while tracing is enabled, accessed atomically */
+extern bool tym_i_trace_enabled;
+
+uint64_t tym_i_trace_now(void);
+void tym_i_trace_end(struct tym_i_pane_internal* pane, enum tym_i_trace_phase phase, uint64_t start);
+
+/** Start a span. Returns its start time, or 0 if tracing is disabled. */
+static inline uint64_t tym_i_trace_begin(void){
+  if(!__atomic_load_n(&tym_i_trace_enabled, __ATOMIC_RELAXED))
+    return 0;
+  return tym_i_trace_now();
+}
+
+#endif
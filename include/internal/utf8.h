@@ -47,6 +47,9 @@ struct tym_i_utf8_character_state {
   uint8_t count;
 };
 
+/** Get the number of bytes of a utf-8 sequence from its first byte, or -1 if it isn't a valid first byte */
+int tym_i_utf8_length(uint8_t b);
+
 /**
  * Check if a byte completes a utf-8 character & add it if possible.
  * 
@@ -0,0 +1,37 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#ifndef TYM_INTERNAL_WORKER_H
+#define TYM_INTERNAL_WORKER_H
+
+#include <internal/pane.h>
+
+/**
+ * \file
+ *
+ * The worker pool. If it's enabled using tym_set_parser_thread_count, the main loop
+ * doesn't read & parse the output of the panes itself, it queues the panes with pending
+ * output, and the next idle worker reads & parses it. A pane is never processed by
+ * more than one worker at a time, so its output is still parsed in order.
+ *
+ * The workers only update the grids & the damage of the panes, they don't draw anything.
+ * The main loop is the only thread passing the changes to the backend, when it renders.
+ */
+
+enum {
+  /** The maximum number of workers, see tym_set_parser_thread_count */
+  TYM_I_WORKER_MAX = 256
+};
+
+/**
+ * The number of workers started by the main loop, or 0 if the main loop parses the output itself.
+ * This can only be changed while the library isn't initialised. If this isn't 0, drawing is deferred
+ * to rendering, see tym_i_pane_render_default_proc.
+ */
+extern unsigned tym_i_worker_count;
+
+int tym_i_worker_start(void);
+void tym_i_worker_stop(void);
+void tym_i_worker_enqueue(struct tym_i_pane_internal* pane);
+
+#endif
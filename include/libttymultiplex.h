@@ -81,6 +81,42 @@ enum tym_button {
   TYM_BUTTON_RELEASED,
 };
 
+/** What to do with data sent to a pane which doesn't fit into its queue, see #tym_set_send_queue_limit */
+enum tym_send_overflow {
+  TYM_SEND_OVERFLOW_FAIL, //!< Don't send the part which doesn't fit, -1 is returned and errno is set to EAGAIN.
+  TYM_SEND_OVERFLOW_DISCARD, //!< Don't send the part which doesn't fit, but don't report an error either.
+};
+
+/** Counters of what a pane did since it was created, see #tym_pane_get_stats */
+struct tym_pane_stats {
+  /** The number of bytes read from the program in the pane */
+  uint64_t bytes_read;
+  /** The number of reads from the pseudo terminal master */
+  uint64_t reads;
+  /** The number of escape sequences which were unknown, malformed or rejected by their handler */
+  uint64_t sequences_unknown;
+  /** The number of invalid utf-8 sequences, each of them is shown as a replacement character */
+  uint64_t utf8_invalid;
+  /** The number of times the screen or its scrolling region was scrolled */
+  uint64_t scrolls;
+  /** The number of cells which were written, including cells which were erased */
+  uint64_t cells_written;
+  /** The number of times changes of the pane were passed to the backend */
+  uint64_t refreshes;
+  /** The total time spent parsing the output of the program, in nanoseconds */
+  uint64_t parse_time;
+  /**
+   * The number of entries in sequence. Has to be set to the size of the array sequence points to.
+   * It's set to the number of escape sequences libttymultiplex knows, which may be more.
+   */
+  size_t sequence_count;
+  /**
+   * How often each escape sequence was handled, may be a null pointer. The name of
+   * the escape sequence at each index can be optained using #tym_sequence_name.
+   */
+  uint64_t* sequence;
+};
+
 #define TYM_I_LOG_LEVEL \
   X(DEBUG) \
   X(INFO) \
@@ -121,10 +157,33 @@ enum tym_log_level {
 #define TYM_LOG_PROJECT 0
 #endif
 
-/** Convinience macro for simpler usage of #TYM_LOG_FUNC. */
-#define TYM_U_LOG(level,...) TYM_LOG_FUNC(TYM_LOG_PROJECT, level, __FILE__, __LINE__, __VA_ARGS__)
+/**
+ * The log levels which are currently logged, one bit per #tym_log_level.
+ * This is 0 if there is nowhere to log to. \see tym_set_log_level
+ */
+TYM_EXPORT extern unsigned tym_u_log_mask;
+
+#ifdef __GNUC__
+#define TYM_I_LOG_MASK __atomic_load_n(&tym_u_log_mask, __ATOMIC_RELAXED)
+#else
+#define TYM_I_LOG_MASK tym_u_log_mask
+#endif
+
+#ifdef TYM_NO_DEBUG_LOG
+/** Check if messages of a log level are logged. Debug messages are never logged if TYM_NO_DEBUG_LOG is defined. */
+#define TYM_U_LOG_ENABLED(level) ((level) != TYM_LOG_DEBUG && (TYM_I_LOG_MASK & (1u << (level))))
+#else
+/** Check if messages of a log level are logged. Debug messages are never logged if TYM_NO_DEBUG_LOG is defined. */
+#define TYM_U_LOG_ENABLED(level) (TYM_I_LOG_MASK & (1u << (level)))
+#endif
+
+/** Convinience macro for simpler usage of #TYM_LOG_FUNC. The arguments are only evaluated if the level is logged. */
+#define TYM_U_LOG(level,...) do { \
+    if(TYM_U_LOG_ENABLED(level)) \
+      TYM_LOG_FUNC(TYM_LOG_PROJECT, level, __FILE__, __LINE__, __VA_ARGS__); \
+  } while(0)
 /** Convinience macro for simpler usage of #TYM_LOG_FUNC. Intended usage similar to perror. */
-#define TYM_U_PERROR(level,message) TYM_LOG_FUNC(TYM_LOG_PROJECT, level, __FILE__, __LINE__, "%s: %s\n", message, strerror(errno))
+#define TYM_U_PERROR(level,message) TYM_U_LOG(level, "%s: %s\n", message, strerror(errno))
 
 /**
  * Different types of positions for tym_position, which differ in what they specify the position in relation to.
@@ -373,6 +432,81 @@ TYM_EXPORT int tym_freeze(void);
  **/
 TYM_EXPORT int tym_zap(void);
 
+/**
+ * Set the maximum number of frames per second a pane gets rendered.
+ * Output of the programs in the panes is processed as it arrives, but the
+ * changes are only passed to the screen at most once per frame. A small amount
+ * of output after a quiet period, such as the echo of a keystroke, is shown immediately.
+ * The default is 60 frames per second. If frames_per_second is 0, the changes are shown
+ * immediately after every read from a pane.
+ * 
+ * This function can also be called before #tym_init.
+ */
+TYM_EXPORT int tym_set_render_rate(unsigned frames_per_second);
+
+/**
+ * Set how much output of a pane is read & processed at most before it's the turn
+ * of the next pane, so that a pane which gets flooded with output can't hold up
+ * the others. Every time it's the turn of a pane, quantum bytes are added to its budget,
+ * and it reads until there is no more output pending or the budget is used up.
+ * Budget which isn't used is kept for the next turn, but at most max bytes,
+ * so that a pane with occasional output can catch up on a burst of output at once.
+ * The defaults are a quantum of 4 KiB and a max of 16 KiB.
+ *
+ * This can only be called while libttymultiplex isn't initialised. If it is,
+ * or if quantum is 0 or bigger than max, -1 is returned and errno is set to EINVAL.
+ */
+TYM_EXPORT int tym_set_read_budget(size_t quantum, size_t max);
+
+/**
+ * Set how much output of a pane may be processed before it has to be shown.
+ * If more than this many bytes were read from a pane since it was rendered the last time,
+ * because the backend can't keep up or the render rate is low, no more output
+ * is read from it until the next frame was rendered. The program writing the output
+ * then has to wait, instead of the output being processed only to be overwritten
+ * before it's ever shown. The default is 1 MiB, 0 disables this.
+ *
+ * This function can also be called before #tym_init.
+ */
+TYM_EXPORT int tym_set_unrendered_limit(size_t bytes);
+
+/**
+ * Set how much data sent to a pane may be queued, and what happens to more data after that.
+ * Keys, mouse events and answers to queries are written to the pseudo terminal of a pane
+ * without waiting. If the program in the pane doesn't read its input, what couldn't be written
+ * yet is queued, and written once the program reads again. At most bytes are queued:
+ * if what couldn't be written right away doesn't fit into the queue anymore, that part isn't sent,
+ * and overflow decides if that's reported as an error. What could be written right away is sent anyway.
+ * The defaults are 256 KiB and #TYM_SEND_OVERFLOW_FAIL.
+ *
+ * This can only be called while libttymultiplex isn't initialised. If it is,
+ * or if overflow isn't a #tym_send_overflow, -1 is returned and errno is set to EINVAL.
+ */
+TYM_EXPORT int tym_set_send_queue_limit(size_t bytes, enum tym_send_overflow overflow);
+
+/**
+ * Set the maximum number of bytes of a control string, like an OSC or DCS string,
+ * which are passed to its handler at once. Control strings aren't buffered and may be
+ * of any length, their content is passed on in parts as it's read. The default is 4 KiB.
+ *
+ * This can only be called while libttymultiplex isn't initialised. If it is,
+ * or if bytes is 0, -1 is returned and errno is set to EINVAL.
+ */
+TYM_EXPORT int tym_set_string_chunk_size(size_t bytes);
+
+/**
+ * Set the number of threads reading & parsing the output of the programs in the panes.
+ * By default, this is 0, and it's done by the main loop of the library. Otherwise, the main
+ * loop hands panes with pending output to a pool of that many threads, and the output of
+ * different panes is parsed in parallel. The output of a single pane is still parsed by one
+ * thread at a time, in order. Only the main loop passes the changes to the backend, when
+ * it renders them, see #tym_set_render_rate.
+ *
+ * This can only be called while libttymultiplex isn't initialised. If it is,
+ * -1 is returned and errno is set to EINVAL.
+ */
+TYM_EXPORT int tym_set_parser_thread_count(unsigned count);
+
 /**
  * Create a new pane. A pane is a region on the screen which contains a virtual
  * terminal. libttymultiplex is an xterm-compatible terminal emulator. Some escape
@@ -504,11 +638,86 @@ TYM_EXPORT int tym_pane_send_special_key_by_name(int pane, const char* key_name)
  */
 TYM_EXPORT int tym_pane_type(int pane, size_t count, const char keys[count]);
 
+/**
+ * Paste some text into the pane. Unlike with #tym_pane_type, the text isn't treated as key presses,
+ * only line breaks are sent as carriage returns, like the enter key. If the program in the pane
+ * enabled bracketed paste mode, the text is enclosed in the escape sequences ESC [ 200 ~ and ESC [ 201 ~,
+ * so that it can tell pasted text from typed text. The text is sent in chunks: if it can't be written
+ * right away, only as much of it as fits is queued, see #tym_set_send_queue_limit, and a copy of the rest
+ * is kept and queued as the program reads its input. Until all of the text was queued, pasting more text
+ * into the pane fails with errno set to EBUSY.
+ */
+TYM_EXPORT int tym_pane_paste(int pane, size_t size, const char data[size]);
+
 /**
  * Send a mouse button event at the specified position.
  */
 TYM_EXPORT int tym_pane_send_mouse_event(int pane, enum tym_button button, const struct tym_super_position*restrict super_position);
 
+/**
+ * Get the counters of a pane, see #tym_pane_stats. Set stats->sequence & stats->sequence_count
+ * before calling this function, or set them to 0 if the counters of the escape sequences aren't needed.
+ */
+TYM_EXPORT int tym_pane_get_stats(int pane, struct tym_pane_stats* stats);
+
+/**
+ * Get the title the program in the pane set using the escape sequence OSC 0 or OSC 2.
+ * At most size bytes, including the terminating null byte, are stored in title.
+ * \returns The length of the title, which is larger than size - 1 if it was truncated, or -1 on error.
+ */
+TYM_EXPORT int tym_pane_get_title(int pane, size_t size, char title[size]);
+
+/**
+ * The name of the escape sequence at the specified index of #tym_pane_stats::sequence,
+ * or a null pointer if there is none.
+ */
+TYM_EXPORT const char* tym_sequence_name(size_t index);
+
+/**
+ * Only log messages of this level or higher. Messages are only logged if a file descriptor
+ * to log to was specified using the TM_DEBUGFD environment variable. The default level is
+ * #TYM_LOG_DEBUG, or the one set using the TM_LOG_LEVEL environment variable, for example
+ * TM_LOG_LEVEL=WARN. Libraries & backends built with TYM_NO_DEBUG_LOG defined never log debug messages.
+ *
+ * This function can also be called before #tym_init.
+ */
+TYM_EXPORT int tym_set_log_level(enum tym_log_level level);
+
+/**
+ * Enable or disable timing how long reading, parsing, handling escape sequences and
+ * rendering the output of the panes takes, as well as handling events in the main loop.
+ * The time spent is summed up per pane, and the most recent spans are kept,
+ * see #tym_trace_dump. Tracing is disabled by default.
+ *
+ * This function can also be called before #tym_init.
+ */
+TYM_EXPORT int tym_set_tracing(bool enable);
+
+/**
+ * Write the most recent spans recorded while tracing was enabled, see #tym_set_tracing,
+ * to a file descriptor, in the Chrome trace event format. It can be viewed using chrome://tracing
+ * or https://ui.perfetto.dev/. Every pane is shown as a thread. The time summed up per pane
+ * is added as tymStats.
+ */
+TYM_EXPORT int tym_trace_dump(int fd);
+
+/**
+ * Enable or disable profiling the escape sequence handlers. For the handler of every escape sequence,
+ * the number of calls and a histogram of the time they took is kept, see #tym_profile_dump.
+ * Profiling is disabled by default.
+ *
+ * This function can also be called before #tym_init.
+ */
+TYM_EXPORT int tym_set_profiling(bool enable);
+
+/**
+ * Write the profile of every escape sequence handler which was called while profiling was enabled,
+ * see #tym_set_profiling, to a file descriptor as text. If fd is -1, it's written to the file descriptor
+ * specified using the TM_DEBUGFD environment variable. This function is async-signal-safe,
+ * it can be called from a signal handler.
+ */
+TYM_EXPORT int tym_profile_dump(int fd);
+
 /**
  * Similar to tym_u_va_log, but doesn't add any extra formatting.
  */
@@ -13,6 +13,7 @@
 #include <ctype.h>
 
 #include <internal/backend.h>
+#include <internal/log.h>
 #include <errno.h>
 #include <string.h>
 
@@ -84,6 +85,7 @@ error_after_backend_register:
   tym_i_backend_entry = 0;
   tym_i_backend = 0;
 error_after_dlopen:
+  tym_i_log_flush();
   dlclose(lib);
 error_after_calloc:
   free((char*)libname);
@@ -248,6 +250,8 @@ void tym_i_backend_unload(bool zap){
     return;
   tym_i_backend->cleanup(zap);
   if(tym_i_backend_entry->library){
+    // Pending log messages may refer to strings of the backend
+    tym_i_log_flush();
     free((char*)tym_i_backend_entry->name);
     dlclose(tym_i_backend_entry->library);
   }
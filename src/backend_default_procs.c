@@ -4,6 +4,10 @@
 #include <internal/backend.h>
 #include <internal/pane.h>
 #include <internal/main.h>
+#include <internal/screen.h>
+#include <internal/utf8.h>
+#include <internal/worker.h>
+#include <string.h>
 
 /**
  * \file
@@ -20,6 +24,22 @@ int tym_i_pane_refresh_default_proc(struct tym_i_pane_internal* pane){
   return 0;
 }
 
+/**
+ * Refreshes the whole pane. Backends which draw the characters as they are set
+ * don't need to know which parts changed. If there are workers, nothing was drawn
+ * while parsing, the changed parts & the cursor are drawn from the grid first.
+ */
+int tym_i_pane_render_default_proc(struct tym_i_pane_internal* pane, size_t count, const struct tym_i_damage_span* span){
+  if(tym_i_worker_count){
+    for(size_t i=0; i<count; i++)
+      if(tym_i_screen_draw(pane, span[i].y, span[i].start, span[i].end) == -1)
+        return -1;
+    if(pane->focus)
+      tym_i_backend->pane_set_cursor_position(pane, pane->damage.cursor_position);
+  }
+  return tym_i_backend->pane_refresh(pane);
+}
+
 /**
  * This is a no-op. A backend may check the cursor state itself every time it displays ist, or just ignore it altogether.
  */
@@ -81,3 +101,48 @@ int tym_i_pane_scroll_default_proc(struct tym_i_pane_internal* pane, int n){
   long h = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_VERTICAL);
   return tym_i_backend->pane_scroll_region(pane, n, 0, h);
 }
+
+/**
+ * The core has already scrolled the content of the screen grid,
+ * just redraw the rows of the region from there.
+ */
+int tym_i_pane_scroll_region_default_proc(struct tym_i_pane_internal* pane, int n, unsigned top, unsigned bottom){
+  if(n == 0)
+    return 0;
+  unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
+  for(unsigned y=top; y<bottom; y++)
+    if(tym_i_screen_draw(pane, y, 0, w) == -1)
+      return -1;
+  return 0;
+}
+
+/**
+ * The core has already removed the characters from the screen grid,
+ * just redraw the rest of the row from there.
+ */
+int tym_i_pane_delete_characters_default_proc(struct tym_i_pane_internal* pane, struct tym_i_cell_position position, unsigned n){
+  (void)n;
+  unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
+  return tym_i_screen_draw(pane, position.y, position.x, w);
+}
+
+/** Sets the characters of the run one at a time using pane_set_character. */
+int tym_i_pane_set_text_run_default_proc(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t count, size_t length, const char utf8[length]
+){
+  for(size_t i=0; i<count && length; i++, position.x++){
+    int n = tym_i_utf8_length(*utf8);
+    if(n <= 0 || (size_t)n > length)
+      n = 1;
+    char character[TYM_I_UTF8_CHARACTER_MAX_BYTE_COUNT+1] = {0};
+    memcpy(character, utf8, n);
+    if(tym_i_backend->pane_set_character(pane, position, format, n, character, false) == -1)
+      return -1;
+    utf8 += n;
+    length -= n;
+  }
+  return 0;
+}
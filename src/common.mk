@@ -19,6 +19,10 @@ CPPCHECK_OPTIONS += $(INCLUDES) $(addprefix -I,$(DEFAULT_INCLUDES)) --std=c99 -D
 CPPCHECK_OPTIONS += --std=c99 -D_POSIX_C_SOURCE -D_DEFAULT_SOURCE -DTYM_BUILD
 CPPCHECK_OPTIONS += $(CPPCHECK_OPTS)
 
+ifdef NO_DEBUG_LOG
+CC_OPTS += -DTYM_NO_DEBUG_LOG
+endif
+
 ifdef DEBUG
 CC_OPTS += -Og -g
 endif
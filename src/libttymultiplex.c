@@ -4,6 +4,7 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
@@ -18,6 +19,7 @@
 #include <internal/pane.h>
 #include <internal/calc.h>
 #include <internal/backend.h>
+#include <internal/worker.h>
 #include <libttymultiplex.h>
 
 /** \file */
@@ -25,6 +27,7 @@
 int tym_init(void){
   int pollctl[2] = {-1,-1};
   int signal_fd = -1;
+  int timer_fd = -1;
   bool sigblocked = false;
   pthread_mutex_lock(&tym_i_lock);
   if(tym_i_binit == INIT_STATE_INITIALISED){
@@ -77,6 +80,14 @@ int tym_init(void){
   if(tym_i_pollfd_add(signal_fd, &(struct tym_i_pollfd_complement){
     .onevent = tym_i_pollhandler_signal_handler
   })) goto error;
+  timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if(timer_fd == -1)
+    goto error;
+  if(tym_i_pollfd_add(timer_fd, &(struct tym_i_pollfd_complement){
+    .onevent = tym_i_pollhandler_render_timer,
+    .onremove = tym_i_pollhandler_render_timer_remove
+  })) goto error;
+  tym_i_render_timer_fd = timer_fd;
   if(tym_i_update_size_all() == -1)
     goto error;
   tym_i_binit = INIT_STATE_INITIALISED;
@@ -91,6 +102,7 @@ error:;
   close(pollctl[0]);
   close(pollctl[1]);
   close(signal_fd);
+  close(timer_fd);
   pthread_mutex_unlock(&tym_i_lock);
   errno = err;
   return -1;
@@ -258,3 +270,84 @@ error:
   pthread_mutex_unlock(&tym_i_lock);
   return -1;
 }
+
+int tym_set_render_rate(unsigned frames_per_second){
+  pthread_mutex_lock(&tym_i_lock);
+  if(frames_per_second > 1000000000u){
+    errno = EINVAL;
+    goto error;
+  }
+  tym_i_render_interval = frames_per_second ? 1000000000l / frames_per_second : 0;
+  pthread_mutex_unlock(&tym_i_lock);
+  return 0;
+error:
+  pthread_mutex_unlock(&tym_i_lock);
+  return -1;
+}
+
+int tym_set_read_budget(size_t quantum, size_t max){
+  pthread_mutex_lock(&tym_i_lock);
+  if(tym_i_binit != INIT_STATE_SHUTDOWN || !quantum || quantum > max){
+    errno = EINVAL;
+    goto error;
+  }
+  tym_i_read_quantum = quantum;
+  tym_i_read_budget_max = max;
+  pthread_mutex_unlock(&tym_i_lock);
+  return 0;
+error:
+  pthread_mutex_unlock(&tym_i_lock);
+  return -1;
+}
+
+int tym_set_unrendered_limit(size_t bytes){
+  pthread_mutex_lock(&tym_i_lock);
+  tym_i_unrendered_limit = bytes;
+  pthread_mutex_unlock(&tym_i_lock);
+  return 0;
+}
+
+int tym_set_send_queue_limit(size_t bytes, enum tym_send_overflow overflow){
+  pthread_mutex_lock(&tym_i_lock);
+  if( tym_i_binit != INIT_STATE_SHUTDOWN
+   || (overflow != TYM_SEND_OVERFLOW_FAIL && overflow != TYM_SEND_OVERFLOW_DISCARD)
+  ){
+    errno = EINVAL;
+    goto error;
+  }
+  tym_i_send_queue_limit = bytes;
+  tym_i_send_overflow = overflow;
+  pthread_mutex_unlock(&tym_i_lock);
+  return 0;
+error:
+  pthread_mutex_unlock(&tym_i_lock);
+  return -1;
+}
+
+int tym_set_string_chunk_size(size_t bytes){
+  pthread_mutex_lock(&tym_i_lock);
+  if(tym_i_binit != INIT_STATE_SHUTDOWN || !bytes){
+    errno = EINVAL;
+    goto error;
+  }
+  tym_i_string_chunk_size = bytes;
+  pthread_mutex_unlock(&tym_i_lock);
+  return 0;
+error:
+  pthread_mutex_unlock(&tym_i_lock);
+  return -1;
+}
+
+int tym_set_parser_thread_count(unsigned count){
+  pthread_mutex_lock(&tym_i_lock);
+  if(tym_i_binit != INIT_STATE_SHUTDOWN || count > TYM_I_WORKER_MAX){
+    errno = EINVAL;
+    goto error;
+  }
+  tym_i_worker_count = count;
+  pthread_mutex_unlock(&tym_i_lock);
+  return 0;
+error:
+  pthread_mutex_unlock(&tym_i_lock);
+  return -1;
+}
@@ -0,0 +1,399 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <internal/log.h>
+#include <internal/main.h>
+#include <libttymultiplex.h>
+
+/** \file */
+
+static const char* loglevel_name[] = {
+#define X(Y) #Y,
+  TYM_I_LOG_LEVEL
+#undef X
+};
+enum { LOG_LEVEL_COUNT = sizeof(loglevel_name) / sizeof(*loglevel_name) };
+
+/** A log message, as stored in the ring of a thread */
+struct tym_i_log_record {
+  /** The time the message was logged at */
+  struct timespec time;
+  enum tym_log_level level;
+  /** Set for messages logged using tym_u_rawlog, they don't get a prefix */
+  bool raw;
+  /** Where the message was logged. These are string literals, they can be used after the fact. */
+  const char* project;
+  const char* file;
+  unsigned line;
+  /** The length of message */
+  unsigned short length;
+  char message[TYM_I_LOG_MESSAGE_MAX];
+};
+
+/**
+ * The log records of a thread. Only the thread writes records and advances tail,
+ * only the thread draining the rings reads them and advances head.
+ */
+struct tym_i_log_ring {
+  /** The next ring in ring_list */
+  struct tym_i_log_ring* next;
+  /** The index of the next record to be drained, accessed atomically */
+  unsigned head;
+  /** The index of the next record to be written, accessed atomically */
+  unsigned tail;
+  /** The number of messages dropped because the ring was full, accessed atomically */
+  unsigned long dropped;
+  /** Set once the thread exited, the ring is freed after it was drained */
+  bool orphaned;
+  /** The part of the current line of the thread which wasn't written yet, only used while draining */
+  size_t line_size;
+  char line[TYM_I_LOG_LINE_MAX];
+  struct tym_i_log_record record[TYM_I_LOG_RING_SIZE];
+};
+
+static int tym_i_debugfd = -1;
+/** The lowest level which is logged, see tym_set_log_level */
+static enum tym_log_level log_level = TYM_LOG_DEBUG;
+unsigned tym_u_log_mask;
+
+/** The ring of the current thread */
+static pthread_key_t ring_key;
+/** All rings, protected by ring_list_lock */
+static struct tym_i_log_ring* ring_list;
+static pthread_mutex_t ring_list_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Only one thread at a time may drain the rings. This lock is held while doing so. */
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Protects drain_cond & drain_started */
+static pthread_mutex_t wake_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Signaled when a record was added while the drain thread was idle */
+static pthread_cond_t drain_cond = PTHREAD_COND_INITIALIZER;
+/** Set if the drain thread was started, accessed atomically */
+static bool drain_started;
+/** Set while the drain thread is idle or about to be, accessed atomically */
+static bool drain_idle;
+
+/** Formatted lines which are about to be written, only used while draining */
+static char output[64 * 1024];
+static size_t output_size;
+
+/** Update tym_u_log_mask after the log level or the debug file descriptor changed */
+static void log_mask_update(void){
+  unsigned mask = 0;
+  if(tym_i_debugfd >= 0)
+    for(unsigned level=log_level; level<LOG_LEVEL_COUNT; level++)
+      mask |= 1u << level;
+  __atomic_store_n(&tym_u_log_mask, mask, __ATOMIC_RELAXED);
+}
+
+static void output_flush(void){
+  size_t offset = 0;
+  while(offset < output_size){
+    ssize_t ret = write(tym_i_debugfd, output + offset, output_size - offset);
+    if(ret == -1 && errno == EINTR)
+      continue;
+    if(ret <= 0)
+      break; // There is nowhere to report this to
+    offset += ret;
+  }
+  output_size = 0;
+}
+
+static void output_append(size_t size, const char* data){
+  if(output_size + size > sizeof(output))
+    output_flush();
+  memcpy(output + output_size, data, size);
+  output_size += size;
+}
+
+static void line_flush(struct tym_i_log_ring* ring){
+  output_append(ring->line_size, ring->line);
+  ring->line_size = 0;
+}
+
+static void line_append(struct tym_i_log_ring* ring, size_t size, const char* data){
+  while(size){
+    if(ring->line_size == sizeof(ring->line))
+      line_flush(ring);
+    size_t n = sizeof(ring->line) - ring->line_size;
+    if(n > size)
+      n = size;
+    memcpy(ring->line + ring->line_size, data, n);
+    ring->line_size += n;
+    data += n;
+    size -= n;
+  }
+}
+
+/** Add a formatted message to the current line of a thread, and write the line once it's complete. */
+static void line_format(struct tym_i_log_ring* ring, const struct tym_i_log_record* record){
+  if(!record->raw){
+    char prefix[256];
+    int n;
+    if(record->line){
+      n = snprintf(prefix, sizeof(prefix), "[%5ld.%06ld] [%s] %s: %s: %u: ",
+        (long)record->time.tv_sec, record->time.tv_nsec / 1000, loglevel_name[record->level],
+        record->project ? record->project : "?", record->file, record->line
+      );
+    }else{
+      n = snprintf(prefix, sizeof(prefix), "[%5ld.%06ld] [%s] %s: %s: ",
+        (long)record->time.tv_sec, record->time.tv_nsec / 1000, loglevel_name[record->level],
+        record->project ? record->project : "?", record->file
+      );
+    }
+    if(n > 0)
+      line_append(ring, (size_t)n < sizeof(prefix) ? (size_t)n : sizeof(prefix) - 1, prefix);
+  }
+  line_append(ring, record->length, record->message);
+  if(ring->line_size && ring->line[ring->line_size-1] == '\n')
+    line_flush(ring);
+}
+
+/** Take the pending records out of a ring. drain_lock has to be held. */
+static void drain_ring(struct tym_i_log_ring* ring){
+  unsigned long dropped = __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+  unsigned tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  for(unsigned head=ring->head; head!=tail; head++){
+    line_format(ring, &ring->record[head % TYM_I_LOG_RING_SIZE]);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+  }
+  if(dropped){
+    char message[128];
+    int n = snprintf(message, sizeof(message), "[WARN] libttymultiplex: %lu log messages of a thread were dropped\n", dropped);
+    if(n > 0)
+      output_append((size_t)n < sizeof(message) ? (size_t)n : sizeof(message) - 1, message);
+  }
+}
+
+/** Take the pending records out of all rings & write them. drain_lock has to be held. */
+static void drain(void){
+  pthread_mutex_lock(&ring_list_lock);
+  for(struct tym_i_log_ring** it=&ring_list; *it; ){
+    struct tym_i_log_ring* ring = *it;
+    drain_ring(ring);
+    if( __atomic_load_n(&ring->orphaned, __ATOMIC_ACQUIRE)
+     && ring->head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)
+    ){
+      line_flush(ring);
+      *it = ring->next;
+      free(ring);
+      continue;
+    }
+    it = &ring->next;
+  }
+  pthread_mutex_unlock(&ring_list_lock);
+  output_flush();
+}
+
+static bool pending(void){
+  bool ret = false;
+  pthread_mutex_lock(&ring_list_lock);
+  for(struct tym_i_log_ring* it=ring_list; it && !ret; it=it->next)
+    ret = __atomic_load_n(&it->head, __ATOMIC_SEQ_CST) != __atomic_load_n(&it->tail, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&ring_list_lock);
+  return ret;
+}
+
+static void* drain_main(void* ptr){
+  (void)ptr;
+  while(true){
+    pthread_mutex_lock(&drain_lock);
+    drain();
+    pthread_mutex_unlock(&drain_lock);
+    pthread_mutex_lock(&wake_lock);
+    __atomic_store_n(&drain_idle, true, __ATOMIC_SEQ_CST);
+    if(!pending())
+      pthread_cond_wait(&drain_cond, &wake_lock);
+    __atomic_store_n(&drain_idle, false, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&wake_lock);
+  }
+  return 0;
+}
+
+/** Start the drain thread, unless it's already running. Returns -1 if it can't be started. */
+static int drain_start(void){
+  int ret = 0;
+  pthread_mutex_lock(&wake_lock);
+  if(!drain_started){
+    // Signals have to be handled by the main loop, see tym_i_pollhandler_signal_handler
+    sigset_t sigmask, oldmask;
+    sigfillset(&sigmask);
+    pthread_sigmask(SIG_BLOCK, &sigmask, &oldmask);
+    pthread_t thread;
+    int err = pthread_create(&thread, 0, drain_main, 0);
+    pthread_sigmask(SIG_SETMASK, &oldmask, 0);
+    if(err){
+      ret = -1;
+    }else{
+      pthread_detach(thread);
+      __atomic_store_n(&drain_started, true, __ATOMIC_RELEASE);
+    }
+  }
+  pthread_mutex_unlock(&wake_lock);
+  return ret;
+}
+
+static void ring_orphan(void* ptr){
+  struct tym_i_log_ring* ring = ptr;
+  __atomic_store_n(&ring->orphaned, true, __ATOMIC_RELEASE);
+}
+
+/** Get the ring of the current thread, or create it */
+static struct tym_i_log_ring* ring_get(void){
+  struct tym_i_log_ring* ring = pthread_getspecific(ring_key);
+  if(ring)
+    return ring;
+  ring = calloc(1, sizeof(*ring));
+  if(!ring)
+    return 0;
+  if(pthread_setspecific(ring_key, ring)){
+    free(ring);
+    return 0;
+  }
+  pthread_mutex_lock(&ring_list_lock);
+  ring->next = ring_list;
+  ring_list = ring;
+  pthread_mutex_unlock(&ring_list_lock);
+  return ring;
+}
+
+/** Add a log record to the ring of the current thread, and make sure it gets written. */
+static void submit(enum tym_log_level level, bool raw, const char* project, const char* file, unsigned line, const char* format, va_list args){
+  struct tym_i_log_ring* ring = ring_get();
+  if(!ring)
+    return;
+  unsigned tail = ring->tail;
+  if(tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) >= TYM_I_LOG_RING_SIZE){
+    __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  struct tym_i_log_record* record = &ring->record[tail % TYM_I_LOG_RING_SIZE];
+  clock_gettime(CLOCK_MONOTONIC, &record->time);
+  record->level = level;
+  record->raw = raw;
+  record->project = project;
+  record->file = file;
+  record->line = line;
+  int n = vsnprintf(record->message, sizeof(record->message), format, args);
+  record->length = n < 0 ? 0 : (size_t)n < sizeof(record->message) ? (size_t)n : sizeof(record->message) - 1;
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+  if(level == TYM_LOG_FATAL || (!__atomic_load_n(&drain_started, __ATOMIC_ACQUIRE) && drain_start() == -1)){
+    // The message may be the last one before the process exits, or there is no drain thread
+    tym_i_log_flush();
+  }else if(__atomic_load_n(&drain_idle, __ATOMIC_SEQ_CST)){
+    pthread_mutex_lock(&wake_lock);
+    pthread_cond_signal(&drain_cond);
+    pthread_mutex_unlock(&wake_lock);
+  }
+}
+
+static void fork_prepare(void){
+  pthread_mutex_lock(&drain_lock);
+  pthread_mutex_lock(&wake_lock);
+  pthread_mutex_lock(&ring_list_lock);
+}
+
+static void fork_parent(void){
+  pthread_mutex_unlock(&ring_list_lock);
+  pthread_mutex_unlock(&wake_lock);
+  pthread_mutex_unlock(&drain_lock);
+}
+
+/** The drain thread doesn't exist in the child process, it's started again if necessary. */
+static void fork_child(void){
+  drain_started = false;
+  drain_idle = false;
+  fork_parent();
+}
+
+/** Open the debug file descriptor and prepare the rings. This is done even before main. */
+void tym_i_log_init(void){
+  const char* debugfd = getenv("TM_DEBUGFD");
+  if(debugfd){
+    int fd = atoi(debugfd);
+    if(fcntl(fd, F_SETFD, FD_CLOEXEC) != -1)
+      tym_i_debugfd = fd;
+  }
+  const char* level = getenv("TM_LOG_LEVEL");
+  for(size_t i=0; level && i<LOG_LEVEL_COUNT; i++)
+    if(!strcmp(level, loglevel_name[i]))
+      log_level = i;
+  if(pthread_key_create(&ring_key, ring_orphan)){
+    tym_i_debugfd = -1;
+  }else{
+    pthread_atfork(fork_prepare, fork_parent, fork_child);
+  }
+  log_mask_update();
+}
+
+/** Write all pending log messages right away. */
+void tym_i_log_flush(void){
+  if(tym_i_debugfd < 0)
+    return;
+  pthread_mutex_lock(&drain_lock);
+  drain();
+  pthread_mutex_unlock(&drain_lock);
+}
+
+/** The debug file descriptor specified using TM_DEBUGFD, or -1. This is async-signal-safe. */
+int tym_i_log_fd(void){
+  return tym_i_debugfd;
+}
+
+int tym_set_log_level(enum tym_log_level level){
+  if((unsigned)level >= LOG_LEVEL_COUNT){
+    errno = EINVAL;
+    return -1;
+  }
+  pthread_mutex_lock(&tym_i_lock);
+  log_level = level;
+  log_mask_update();
+  pthread_mutex_unlock(&tym_i_lock);
+  return 0;
+}
+
+/**
+ * Similar to perror, but prints output to tym_i_debugfd.
+ *
+ * \see tym_i_debug
+ */
+void tym_u_perror(const char* project, enum tym_log_level level, const char* file, unsigned line, const char* message){
+  tym_u_log(project, level, file, line, "%s: %d %s\n", message, errno, strerror(errno));
+}
+
+void tym_u_va_rawlog(enum tym_log_level level, const char* format, va_list args){
+  if(!TYM_U_LOG_ENABLED(level))
+    return;
+  submit(level, true, 0, 0, 0, format, args);
+}
+
+void tym_u_rawlog(enum tym_log_level level, const char* format, ...){
+  va_list args;
+  va_start(args, format);
+  tym_u_va_rawlog(level, format, args);
+  va_end(args);
+}
+
+void tym_u_va_log(const char* project, enum tym_log_level level, const char* file, unsigned line, const char* format, va_list args){
+  if(!TYM_U_LOG_ENABLED(level))
+    return;
+  submit(level, false, project, file, line, format, args);
+}
+
+void tym_u_log(const char* project, enum tym_log_level level, const char* file, unsigned line, const char* format, ...){
+  va_list args;
+  va_start(args, format);
+  tym_u_va_log(project, level, file, line, format, args);
+  va_end(args);
+}
@@ -3,6 +3,7 @@
 
 #include <pty.h>
 #include <poll.h>
+#include <sys/epoll.h>
 #include <errno.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -11,32 +12,42 @@
 #include <unistd.h>
 #include <signal.h>
 #include <sys/signalfd.h>
+#include <sys/timerfd.h>
 #include <assert.h>
 #include <internal/list.h>
+#include <internal/log.h>
 #include <internal/main.h>
 #include <internal/pane.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <internal/backend.h>
+#include <internal/screen.h>
+#include <internal/worker.h>
 #include <libttymultiplex.h>
 
 /** \file */
 
-static const char* loglevel_name[] = {
-#define X(Y) #Y,
-  TYM_I_LOG_LEVEL
-#undef X
-};
-
 enum tym_i_init_state tym_i_binit = INIT_STATE_NOINIT;
 int tym_i_cmd_fd = -1;
 size_t tym_i_poll_count;
-struct pollfd* tym_i_poll_list;
-struct tym_i_pollfd_complement* tym_i_poll_list_complement;
+int tym_i_epoll_fd = -1;
+size_t tym_i_pollfd_table_size;
+struct tym_i_pollfd_entry** tym_i_pollfd_table;
 struct tym_absolute_position_rectangle tym_i_bounds;
+unsigned tym_i_bounds_generation;
 pthread_t tym_i_main_loop;
 pthread_mutexattr_t tym_i_lock_attr;
 pthread_mutex_t tym_i_lock;
+pthread_mutex_t tym_i_backend_lock;
+
+long tym_i_render_interval = 1000000000l / TYM_I_DEFAULT_RENDER_RATE;
+int tym_i_render_timer_fd = -1;
+size_t tym_i_read_quantum = TYM_I_DEFAULT_READ_QUANTUM;
+size_t tym_i_read_budget_max = TYM_I_DEFAULT_READ_BUDGET_MAX;
+size_t tym_i_unrendered_limit = TYM_I_DEFAULT_UNRENDERED_LIMIT;
+size_t tym_i_send_queue_limit = TYM_I_DEFAULT_SEND_QUEUE_LIMIT;
+enum tym_send_overflow tym_i_send_overflow = TYM_SEND_OVERFLOW_FAIL;
+size_t tym_i_string_chunk_size = TYM_I_DEFAULT_STRING_CHUNK_SIZE;
 
 size_t tym_i_resize_handler_count;
 struct tym_i_resize_handler_ptr_pair* tym_i_resize_handler_list;
@@ -52,28 +63,21 @@ const struct tym_special_key_name tym_special_key_list[] = { TYM_I_SPECIAL_KEYS(
 #undef Y1
 const size_t tym_special_key_count = sizeof(tym_special_key_list) / sizeof(*tym_special_key_list);
 
-static int tym_i_debugfd = -1;
-
-/** Open the debug file descriptor and initialise mutex attributes. This is done even before main. */
+/** Set up logging and initialise mutex attributes. This is done even before main. */
 static void init(void) __attribute__((constructor,used));
 static void init(void){
-  {
-    const char* debugfd = getenv("TM_DEBUGFD");
-    if(debugfd){
-      int fd = atoi(debugfd);
-      if(fcntl(fd, F_SETFD, FD_CLOEXEC) != -1)
-        tym_i_debugfd = fd;
-    }
-  }
+  tym_i_log_init();
   pthread_mutexattr_init(&tym_i_lock_attr);
   pthread_mutexattr_settype(&tym_i_lock_attr, PTHREAD_MUTEX_RECURSIVE);
   pthread_mutex_init(&tym_i_lock, &tym_i_lock_attr);
+  pthread_mutex_init(&tym_i_backend_lock, &tym_i_lock_attr);
 }
 
 /** This is automatically called before the program exits. This is to make sure everything always gets properly deinitialised. */
 static void shutdown(void) __attribute__((destructor,used));
 static void shutdown(void){
   tym_shutdown();
+  tym_i_log_flush();
 }
 
 /** Add a reseize handler */
@@ -86,103 +90,196 @@ int tym_i_resize_handler_remove(size_t entry){
   return tym_i_list_remove(sizeof(*tym_i_resize_handler_list), &tym_i_resize_handler_count, (void**)&tym_i_resize_handler_list, entry);
 }
 
-/**
- * Add the poll file descriptor. This should only be used in the main loop.
- * In all other cases, use tym_i_pollfd_add.
- */
-static int pollfd_add_sub(struct pollfd pfd, const struct tym_i_pollfd_complement* complement){
-  size_t n1 = tym_i_poll_count;
-  if(tym_i_list_add(sizeof(*tym_i_poll_list), &n1, (void**)&tym_i_poll_list, &pfd) == -1){
-    assert(n1 == tym_i_poll_count); // Adding an entry failed, the number of list entries should have stayed the same.
+enum {
+  /** The maximum number of events fetched by a single epoll_wait call */
+  TYM_I_MAX_EVENTS = 64
+};
+
+/** Used to tell the file descriptors apart from earlier ones with the same number, see tym_i_pollfd_entry::generation */
+static uint32_t pollfd_generation;
+
+/** Convert epoll events to the poll events passed to tym_i_pollfd_complement::onevent */
+static short epoll_to_poll_events(uint32_t events){
+  short revents = 0;
+  if(events & EPOLLIN ) revents |= POLLIN;
+  if(events & EPOLLPRI) revents |= POLLPRI;
+  if(events & EPOLLOUT) revents |= POLLOUT;
+  if(events & EPOLLERR) revents |= POLLERR;
+  if(events & EPOLLHUP) revents |= POLLHUP;
+  return revents;
+}
+
+/** Get the entry of a watched file descriptor, or 0 if it isn't watched. */
+static struct tym_i_pollfd_entry* pollfd_get(int fd){
+  if(fd < 0 || (size_t)fd >= tym_i_pollfd_table_size)
+    return 0;
+  return tym_i_pollfd_table[fd];
+}
+
+/** The epoll event of a watched file descriptor */
+static struct epoll_event pollfd_event(const struct tym_i_pollfd_entry* entry){
+  return (struct epoll_event){
+    .events = entry->events,
+    .data.u64 = (uint64_t)entry->generation << 32 | (uint32_t)entry->fd
+  };
+}
+
+/** Make sure the epoll file descriptor exists. It's created when the first file descriptor is added. */
+static int epoll_prepare(void){
+  if(tym_i_epoll_fd != -1)
+    return 0;
+  tym_i_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if(tym_i_epoll_fd == -1)
     return -1;
-  }
-  size_t n2 = tym_i_poll_count;
-  if(tym_i_list_add(sizeof(*tym_i_poll_list_complement), &n2, (void**)&tym_i_poll_list_complement, complement) == -1){
-    tym_i_list_remove(sizeof(*tym_i_poll_list), &n1, (void**)&tym_i_poll_list, tym_i_poll_count);
-    assert(n1 == n2); // These lists must always have the same length
-    assert(n1 == tym_i_poll_count); // The number of list entries should have been the same as at the beginning.
+  return 0;
+}
+
+/** Grow tym_i_pollfd_table so that the file descriptor fits in. */
+static int pollfd_table_reserve(int fd){
+  if((size_t)fd < tym_i_pollfd_table_size)
+    return 0;
+  size_t size = tym_i_pollfd_table_size ? tym_i_pollfd_table_size : 32;
+  while(size <= (size_t)fd)
+    size *= 2;
+  struct tym_i_pollfd_entry** table = realloc(tym_i_pollfd_table, size * sizeof(*table));
+  if(!table)
     return -1;
-  }
-  assert(n1 == n2); // These lists must always have the same length
-  assert(n1 == tym_i_poll_count+1); // Exactly one entry should have been added to both lists.
-  tym_i_poll_count = n1;
+  memset(table + tym_i_pollfd_table_size, 0, (size - tym_i_pollfd_table_size) * sizeof(*table));
+  tym_i_pollfd_table = table;
+  tym_i_pollfd_table_size = size;
   return 0;
 }
 
 /**
- * Removes a poll file descriptor using its list index. Only to be used in the main loop.
- * In all other cases, use tym_i_pollfd_remove.
+ * Removes a watched file descriptor, calls its onremove handler & closes it.
+ * If zap is set, the file descriptor isn't removed from the epoll instance.
+ * This is necessary after a fork, because the epoll instance is still shared with the parent process.
  */
-static int pollfd_remove_sub(size_t entry){
-  if(entry >= tym_i_poll_count){
-    errno = EINVAL;
-    return -1;
-  }
-  struct tym_i_pollfd_complement* plc = &tym_i_poll_list_complement[entry];
-  if(plc->onremove)
-    tym_i_poll_list_complement[entry].onremove(tym_i_poll_list_complement[entry].ptr, tym_i_poll_list[entry].fd);
-  close(tym_i_poll_list[entry].fd);
-  size_t n1 = tym_i_poll_count;
-  size_t n2 = tym_i_poll_count;
-  bool ok = true;
-  bool res;
-  res = tym_i_list_remove(sizeof(*tym_i_poll_list), &n1, (void**)&tym_i_poll_list, entry);
-  ok = ok && res;
-  res = tym_i_list_remove(sizeof(*tym_i_poll_list_complement), &n2, (void**)&tym_i_poll_list_complement, entry);
-  ok = ok && res;
-  assert(n1 == n2); // These lists must always have the same length
-  assert(n1 <= tym_i_poll_count); // These lists can't have increased in size
-  ok = ok && tym_i_poll_count-1 == n1;
-  tym_i_poll_count = n1;
-  return -!ok;
+static int pollfd_remove_sub(struct tym_i_pollfd_entry* entry, bool zap){
+  int fd = entry->fd;
+  if(!zap && epoll_ctl(tym_i_epoll_fd, EPOLL_CTL_DEL, fd, 0) == -1)
+    TYM_U_PERROR(TYM_LOG_WARN, "epoll_ctl EPOLL_CTL_DEL failed");
+  tym_i_pollfd_table[fd] = 0;
+  tym_i_poll_count -= 1;
+  if(entry->complement.onremove)
+    entry->complement.onremove(entry->complement.ptr, fd);
+  free(entry);
+  close(fd);
+  return 0;
 }
 
-/** Add a file descriptor to be polled. */
+/**
+ * Add a file descriptor to be watched by the main loop.
+ * This can be called from any thread, as long as tym_i_lock is held.
+ * The file descriptor is added to the epoll instance directly,
+ * the main loop will notice it the next time epoll_wait returns.
+ */
 int tym_i_pollfd_add(int fd, const struct tym_i_pollfd_complement* complement){
   if(fd < 1 || !complement->onevent){
     errno = EINVAL;
     return -1;
   }
-  if(tym_i_binit != INIT_STATE_INITIALISED){
-    return pollfd_add_sub((struct pollfd){
-      .fd = fd,
-      .events = POLLIN | POLLHUP
-    }, complement);
-  }else{
-    struct tym_i_poll_ctl ctl;
-    memset(&ctl, 0, sizeof(ctl));
-    ctl.action = TYM_PC_ADD,
-    ctl.data.add.fd = fd;
-    ctl.data.add.complement = *complement;
-    ssize_t ret = 0;
-    while((ret=write(tym_i_cmd_fd, &ctl, sizeof(ctl))) == -1 && errno == EINTR);
-    if(ret == -1)
-      return -1;
+  if(pollfd_get(fd)){
+    errno = EEXIST;
+    return -1;
   }
+  if(epoll_prepare() == -1)
+    return -1;
+  if(pollfd_table_reserve(fd) == -1)
+    return -1;
+  struct tym_i_pollfd_entry* entry = malloc(sizeof(*entry));
+  if(!entry)
+    return -1;
+  *entry = (struct tym_i_pollfd_entry){
+    .fd = fd,
+    .generation = ++pollfd_generation,
+    .events = EPOLLIN | (complement->edge_triggered ? EPOLLET : 0) | (complement->oneshot ? EPOLLONESHOT : 0),
+    .complement = *complement
+  };
+  struct epoll_event event = pollfd_event(entry);
+  if(epoll_ctl(tym_i_epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1){
+    free(entry);
+    return -1;
+  }
+  tym_i_pollfd_table[fd] = entry;
+  tym_i_poll_count += 1;
   return 0;
 }
 
-/** Remove the file descriptor from the ones watched by the main loop. */
+/** Remove the file descriptor from the ones watched by the main loop. This calls the onremove handler and closes the file descriptor. */
 int tym_i_pollfd_remove(int fd){
-  struct tym_i_poll_ctl ctl;
-  memset(&ctl, 0, sizeof(ctl));
-  ctl.action = TYM_PC_REMOVE;
-  ctl.data.remove.fd = fd;
-  for(size_t i=0; i<tym_i_poll_count; i++){
-    if(tym_i_poll_list[i].fd != fd)
-      continue;
-    tym_i_poll_list_complement[i].onevent = 0;
-    if(tym_i_binit != INIT_STATE_INITIALISED)
-      return pollfd_remove_sub(i);
-    break;
+  struct tym_i_pollfd_entry* entry = pollfd_get(fd);
+  if(!entry){
+    errno = ENOENT;
+    return -1;
   }
-  ssize_t ret = 0;
-  while((ret=write(tym_i_cmd_fd, &ctl, sizeof(ctl))) == -1 && errno == EINTR);
-  if(ret == -1)
+  return pollfd_remove_sub(entry, false);
+}
+
+/**
+ * Watch a file descriptor added with tym_i_pollfd_complement::oneshot set again after its last event was dealt with.
+ * If it's still ready, the main loop is notified right away. Nothing is done while it's paused. tym_i_lock has to be held.
+ */
+int tym_i_pollfd_rearm(int fd){
+  struct tym_i_pollfd_entry* entry = pollfd_get(fd);
+  if(!entry){
+    errno = ENOENT;
+    return -1;
+  }
+  entry->disarmed = false;
+  if(entry->paused)
+    return 0;
+  struct epoll_event event = pollfd_event(entry);
+  return epoll_ctl(tym_i_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+}
+
+/**
+ * Stop watching a file descriptor for a while, or continue watching it, without removing it.
+ * While it's paused, no events are dispatched for it, not even a hangup. tym_i_lock has to be held.
+ */
+int tym_i_pollfd_pause(int fd, bool pause){
+  struct tym_i_pollfd_entry* entry = pollfd_get(fd);
+  if(!entry){
+    errno = ENOENT;
+    return -1;
+  }
+  if(entry->paused == pause)
+    return 0;
+  // It's watched again by tym_i_pollfd_rearm
+  if(entry->disarmed){
+    entry->paused = pause;
+    return 0;
+  }
+  struct epoll_event event = pollfd_event(entry);
+  // Errors & hangups are always reported, EPOLLONESHOT makes sure that this happens at most once.
+  if(pause)
+    event.events = EPOLLONESHOT;
+  if(epoll_ctl(tym_i_epoll_fd, EPOLL_CTL_MOD, fd, &event) == -1)
     return -1;
+  entry->paused = pause;
   return 0;
 }
 
+/**
+ * Watch a file descriptor for POLLOUT in addition to POLLIN, or stop doing so.
+ * If it's paused or disarmed, this takes effect once it's watched again. tym_i_lock has to be held.
+ */
+int tym_i_pollfd_watch_output(int fd, bool watch){
+  struct tym_i_pollfd_entry* entry = pollfd_get(fd);
+  if(!entry){
+    errno = ENOENT;
+    return -1;
+  }
+  uint32_t events = watch ? entry->events | EPOLLOUT : entry->events & ~EPOLLOUT;
+  if(entry->events == events)
+    return 0;
+  entry->events = events;
+  if(entry->paused || entry->disarmed)
+    return 0;
+  struct epoll_event event = pollfd_event(entry);
+  return epoll_ctl(tym_i_epoll_fd, EPOLL_CTL_MOD, fd, &event);
+}
+
 /** Send the main loop the command to exit. */
 int tym_i_request_freeze(void){
   enum tym_i_init_state init = tym_i_binit;
@@ -199,15 +296,35 @@ int tym_i_request_freeze(void){
   return 0;
 }
 
+/**
+ * Tell the main loop that data is queued for sending to a pane, see tym_i_pts_send.
+ * This doesn't need tym_i_lock, so it can be used while only the lock of the pane is held.
+ */
+int tym_i_request_send_queue_flush(int pane){
+  struct tym_i_poll_ctl ctl;
+  memset(&ctl, 0, sizeof(ctl));
+  ctl.action = TYM_PC_SEND_QUEUED;
+  ctl.pane = pane;
+  ssize_t ret = 0;
+  while((ret=write(tym_i_cmd_fd, &ctl, sizeof(ctl))) == -1 && errno == EINTR);
+  return ret == -1 ? -1 : 0;
+}
+
 /** Update the size & position of all panes and everything. Usually done after the terminal size changes. */
 int tym_i_update_size_all(void){
-  if(tym_i_backend->update_terminal_size_information() == -1)
+  pthread_mutex_lock(&tym_i_backend_lock);
+  int ret = tym_i_backend->update_terminal_size_information();
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  if(ret == -1)
     return -1;
+  tym_i_bounds_generation++;
   for(size_t i=0; i<tym_i_resize_handler_count; i++){
     struct tym_i_resize_handler_ptr_pair* cp = tym_i_resize_handler_list + i;
     cp->callback(cp->ptr, &tym_i_bounds);
   }
+  pthread_mutex_lock(&tym_i_backend_lock);
   tym_i_backend->resize();
+  pthread_mutex_unlock(&tym_i_backend_lock);
   for(struct tym_i_pane_internal* it=tym_i_pane_list_start; it; it=it->next)
     tym_i_pane_update_size(it);
   return 0;
@@ -225,24 +342,15 @@ int tym_i_pollhandler_ctl_command_handler(void* ptr, short event, int fd){
     return -1;
   }
   switch(ctl.action){
-    case TYM_PC_ADD: {
-      pollfd_add_sub((struct pollfd){
-        .fd = ctl.data.add.fd,
-        .events = POLLIN | POLLHUP
-      }, &ctl.data.add.complement);
-    } break;
-    case TYM_PC_REMOVE: {
-      for(size_t i=0; i<tym_i_poll_count; i++){
-        if(tym_i_poll_list[i].fd != ctl.data.remove.fd)
-          continue;
-        pollfd_remove_sub(i);
-        break;
-      }
-    } break;
     case TYM_PC_FREEZE: {
       if(tym_i_binit == INIT_STATE_FREEZE_IN_PROGRESS)
         tym_i_binit = INIT_STATE_FROZEN;
     } break;
+    case TYM_PC_SEND_QUEUED: {
+      struct tym_i_pane_internal* pane = tym_i_pane_get(ctl.pane);
+      if(pane && tym_i_pollfd_watch_output(pane->master, true) == -1)
+        TYM_U_PERROR(TYM_LOG_ERROR, "tym_i_pollfd_watch_output failed");
+    } break;
   }
   return 0;
 }
@@ -277,8 +385,14 @@ int tym_i_pollhandler_signal_handler(void* ptr, short event, int fd){
 
 void tym_i_finalize_cleanup(bool zap){
 
-  while(tym_i_poll_count)
-    pollfd_remove_sub(0);
+  for(size_t i=0; i<tym_i_pollfd_table_size && tym_i_poll_count; i++)
+    if(tym_i_pollfd_table[i])
+      pollfd_remove_sub(tym_i_pollfd_table[i], zap);
+  free(tym_i_pollfd_table);
+  tym_i_pollfd_table = 0;
+  tym_i_pollfd_table_size = 0;
+  close(tym_i_epoll_fd);
+  tym_i_epoll_fd = -1;
 
   sigset_t sigmask;
   sigemptyset(&sigmask);
@@ -295,84 +409,169 @@ void tym_i_finalize_cleanup(bool zap){
 
 }
 
-/** The main loop */
+/** Was a frame rendered recently, and is the render timer still running? */
+static bool render_timer_armed;
+
+/** Start the render timer, the pending changes will be rendered once it expires after delay nanoseconds */
+static void render_timer_arm(long delay){
+  if(render_timer_armed || tym_i_render_timer_fd == -1)
+    return;
+  // A zero value would disarm the timer instead
+  if(delay <= 0)
+    delay = 1;
+  struct itimerspec spec = {
+    .it_value = {
+      .tv_sec  = delay / 1000000000l,
+      .tv_nsec = delay % 1000000000l,
+    }
+  };
+  if(timerfd_settime(tym_i_render_timer_fd, 0, &spec, 0) == -1){
+    TYM_U_PERROR(TYM_LOG_ERROR, "timerfd_settime failed");
+    return;
+  }
+  render_timer_armed = true;
+}
+
+/**
+ * Called after output of a pane was processed. If no frame was rendered recently and
+ * only a few bytes were read, as for the echo of a keystroke, the pane is rendered immediately.
+ * Otherwise, the changes are left for the render timer, so that a pane which receives
+ * a lot of output is rendered at most once per frame interval.
+ * If there are workers, only the main loop renders, the timer is set to expire right away instead.
+ * tym_i_lock has to be held.
+ */
+void tym_i_render_schedule(struct tym_i_pane_internal* pane, size_t size){
+  pthread_mutex_lock(&pane->lock);
+  if(!pane->damage.any && !pane->damage.cursor){
+    // Nothing has to be shown, so nothing is waiting to be rendered either
+    pane->unrendered = 0;
+    goto done;
+  }
+  bool immediate = tym_i_render_interval <= 0 || (!render_timer_armed && size <= TYM_I_RENDER_IMMEDIATE_MAX);
+  if(tym_i_worker_count && tym_i_render_timer_fd != -1){
+    render_timer_arm(immediate ? 0 : tym_i_render_interval);
+    goto done;
+  }
+  if(tym_i_render_interval <= 0 || tym_i_render_timer_fd == -1){
+    tym_i_pane_render(pane);
+    goto done;
+  }
+  if(immediate)
+    tym_i_pane_render(pane);
+  render_timer_arm(tym_i_render_interval);
+done:
+  pthread_mutex_unlock(&pane->lock);
+}
+
+/** Render all panes with pending changes once the render timer expires */
+int tym_i_pollhandler_render_timer(void* ptr, short event, int fd){
+  if(!(event & POLLIN))
+    return -1;
+  (void)ptr;
+  uint64_t expirations;
+  while(read(fd, &expirations, sizeof(expirations)) == -1 && errno == EINTR);
+  render_timer_armed = false;
+  bool rendered = false;
+  for(struct tym_i_pane_internal* it=tym_i_pane_list_start; it; it=it->next){
+    pthread_mutex_lock(&it->lock);
+    if(it->damage.any || it->damage.cursor){
+      tym_i_pane_render(it);
+      rendered = true;
+    }
+    pthread_mutex_unlock(&it->lock);
+    tym_i_pane_flow_control(it);
+  }
+  // Keep the timer running for another frame, so that a burst of output right after this doesn't bypass it.
+  if(rendered && tym_i_render_interval > 0)
+    render_timer_arm(tym_i_render_interval);
+  return 0;
+}
+
+/** The render timer file descriptor has been closed */
+int tym_i_pollhandler_render_timer_remove(void* ptr, int fd){
+  (void)ptr;
+  (void)fd;
+  tym_i_render_timer_fd = -1;
+  render_timer_armed = false;
+  return 0;
+}
+
+/**
+ * The main loop.
+ * Only the file descriptors which are ready are dispatched, the cost of an iteration doesn't depend on the number of watched file descriptors.
+ * The workers, if there are any, are started & stopped together with the main loop.
+ */
 void* tym_i_main(void* ptr){
   (void)ptr;
+  struct epoll_event events[TYM_I_MAX_EVENTS];
+  if(tym_i_worker_start() == -1){
+    TYM_U_PERROR(TYM_LOG_FATAL, "tym_i_worker_start failed");
+    pthread_mutex_lock(&tym_i_lock);
+    goto shutdown;
+  }
+  pthread_mutex_lock(&tym_i_lock);
   while(tym_i_poll_count){
-    int ret = poll(tym_i_poll_list, tym_i_poll_count, -1);
+    pthread_mutex_unlock(&tym_i_lock);
+    int ret = epoll_wait(tym_i_epoll_fd, events, TYM_I_MAX_EVENTS, -1);
     pthread_mutex_lock(&tym_i_lock);
     if(ret == -1){
       if(errno == EINTR)
         goto cont;
-      perror("poll failed");
+      perror("epoll_wait failed");
       goto shutdown;
     }
     if( tym_i_binit != INIT_STATE_INITIALISED
      && tym_i_binit != INIT_STATE_FREEZE_IN_PROGRESS
     ) goto shutdown;
-    for(size_t i=0; i<tym_i_poll_count; i++){
-      struct pollfd* pfd = &tym_i_poll_list[i];
-      struct tym_i_pollfd_complement* pc = &tym_i_poll_list_complement[i];
-      if(!pfd->revents)
-        continue;
-      if( pfd->revents & (POLLERR|POLLNVAL) || !pc->onevent
-       || pc->onevent(pc->ptr, pfd->revents, pfd->fd) == -1
-      ){
-        pollfd_remove_sub(i);
+    // The kernel stopped watching the oneshot file descriptors of these events, see tym_i_pollfd_watch_output
+    for(int i=0; i<ret; i++){
+      struct tym_i_pollfd_entry* entry = pollfd_get((uint32_t)events[i].data.u64);
+      if(entry && entry->generation == events[i].data.u64 >> 32 && entry->complement.oneshot && !entry->paused)
+        entry->disarmed = true;
+    }
+    for(int i=0; i<ret; i++){
+      int fd = (uint32_t)events[i].data.u64;
+      uint32_t generation = events[i].data.u64 >> 32;
+      struct tym_i_pollfd_entry* entry = pollfd_get(fd);
+      if(!entry || entry->generation != generation)
+        continue; // The file descriptor has been removed in the meantime
+      if(entry->paused)
+        continue; // The event is reported again once it's no longer paused
+      short revents = epoll_to_poll_events(events[i].events);
+      uint64_t start = tym_i_trace_begin();
+      int result = revents & (POLLERR|POLLNVAL) ? -1 : entry->complement.onevent(entry->complement.ptr, revents, fd);
+      tym_i_trace_end(0, TYM_I_TRACE_DISPATCH, start);
+      if(result == -1){
+        // The onevent handler may have removed or replaced the entry itself
+        entry = pollfd_get(fd);
+        if(entry && entry->generation == generation)
+          pollfd_remove_sub(entry, false);
         continue;
       }
       if(tym_i_binit == INIT_STATE_FROZEN){
+        // The remaining events are reported again once the main loop is started again, unless they were oneshot events
+        for(int j=i+1; j<ret; j++){
+          struct tym_i_pollfd_entry* rest = pollfd_get((uint32_t)events[j].data.u64);
+          if(rest && rest->generation == events[j].data.u64 >> 32 && rest->complement.oneshot)
+            tym_i_pollfd_rearm(rest->fd);
+        }
         goto exit;
       }else if( tym_i_binit != INIT_STATE_INITIALISED
              && tym_i_binit != INIT_STATE_FREEZE_IN_PROGRESS
       ) goto shutdown;
     }
-  cont:
-    pthread_mutex_unlock(&tym_i_lock);
+  cont:;
   }
 shutdown:
+  // The workers may be waiting for tym_i_lock
+  pthread_mutex_unlock(&tym_i_lock);
+  tym_i_worker_stop();
+  pthread_mutex_lock(&tym_i_lock);
   tym_i_finalize_cleanup(false);
+  pthread_mutex_unlock(&tym_i_lock);
+  return 0;
 exit:
   pthread_mutex_unlock(&tym_i_lock);
+  tym_i_worker_stop();
   return 0;
 }
-
-/**
- * Similar to perror, but prints output to tym_i_debugfd.
- * 
- * \see tym_i_debug
- */
-void tym_u_perror(const char* project, enum tym_log_level level, const char* file, unsigned line, const char* message){
-  tym_u_log(project, level, file, line, "%s: %d %s\n", message, errno, strerror(errno));
-}
-
-void tym_u_va_rawlog(enum tym_log_level level, const char* format, va_list args){
-  (void)level;
-  vdprintf(tym_i_debugfd, format, args);
-}
-
-void tym_u_rawlog(enum tym_log_level level, const char* format, ...){
-  va_list args;
-  va_start(args, format);
-  tym_u_va_rawlog(level, format, args);
-  va_end(args);
-}
-
-void tym_u_va_log(const char* project, enum tym_log_level level, const char* file, unsigned line, const char* format, va_list args){
-  if(tym_i_debugfd < 0)
-    return;
-  dprintf(tym_i_debugfd, "[%s] ", loglevel_name[level]);
-  dprintf(tym_i_debugfd, "%s: ", project ? project : "?");
-  dprintf(tym_i_debugfd, "%s: ", file);
-  if(!line)
-    dprintf(tym_i_debugfd, "%d: ", line);
-  vdprintf(tym_i_debugfd, format, args);
-  va_end(args);
-}
-
-void tym_u_log(const char* project, enum tym_log_level level, const char* file, unsigned line, const char* format, ...){
-  va_list args;
-  va_start(args, format);
-  tym_u_va_log(project, level, file, line, format, args);
-  va_end(args);
-}
@@ -21,7 +21,9 @@
 #include <internal/parser.h>
 #include <internal/pseudoterminal.h>
 #include <internal/backend.h>
+#include <internal/screen.h>
 #include <internal/terminfo_helper.h>
+#include <internal/worker.h>
 #include <libttymultiplex.h>
 
 /** \file */
@@ -43,15 +45,19 @@ bool tym_i_character_is_utf8(struct tym_i_character character){
   return true;
 }
 
-/** Recalculate the position and size of the pane and call the reseize handlers. */
-void tym_i_pane_update_size(struct tym_i_pane_internal* pane){
-  tym_i_calc_rectangle_absolut_position(&pane->absolute_position, &pane->super_position);
+/** Set the computed position and size of the pane and call the reseize handlers. The lock of the pane has to be held. */
+static void pane_apply_size(struct tym_i_pane_internal* pane, const struct tym_absolute_position_rectangle* absolute_position, unsigned generation){
+  pane->absolute_position = *absolute_position;
+  pane->bounds_generation = generation;
   for(size_t i=0; i<pane->resize_handler_count; i++){
     struct tym_i_pane_resize_handler_ptr_pair* cp = pane->resize_handler_list + i;
     cp->callback(cp->ptr, pane->id, &pane->super_position, &pane->absolute_position);
   }
+  tym_i_screen_resize(pane);
+  pthread_mutex_lock(&tym_i_backend_lock);
   tym_i_backend->pane_resize(pane);
   tym_i_backend->pane_refresh(pane);
+  pthread_mutex_unlock(&tym_i_backend_lock);
   unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
   unsigned h = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_VERTICAL);
   struct winsize size = {
@@ -62,6 +68,15 @@ void tym_i_pane_update_size(struct tym_i_pane_internal* pane){
     TYM_U_PERROR(TYM_LOG_ERROR, "ioctl TIOCSWINSZ failed");
 }
 
+/** Recalculate the position and size of the pane and call the reseize handlers. tym_i_lock must be held. */
+void tym_i_pane_update_size(struct tym_i_pane_internal* pane){
+  pthread_mutex_lock(&pane->lock);
+  struct tym_absolute_position_rectangle absolute_position;
+  tym_i_calc_rectangle_absolut_position(&absolute_position, &pane->super_position);
+  pane_apply_size(pane, &absolute_position, tym_i_bounds_generation);
+  pthread_mutex_unlock(&pane->lock);
+}
+
 /** Add a resize handler for a pane */
 int tym_i_pane_resize_handler_add(struct tym_i_pane_internal* pane, const struct tym_i_pane_resize_handler_ptr_pair* cp){
   return tym_i_list_add(sizeof(*pane->resize_handler_list), &pane->resize_handler_count, (void**)&pane->resize_handler_list, cp);
@@ -101,7 +116,85 @@ struct tym_i_pane_internal* tym_i_pane_get(int pane){
   return 0;
 }
 
-/** Set the focus on a pane. THis will set tym_i_focus_pane. */
+/**
+ * Get a pane by its id and lock it. tym_i_lock isn't held while waiting for the lock of the pane,
+ * so a pane which is busy doesn't hold up anything concerning other panes.
+ * The pane has to be released using tym_i_pane_release afterwards.
+ *
+ * \returns The pane, or 0 and sets errno if the library isn't initialised or there is no such pane.
+ */
+struct tym_i_pane_internal* tym_i_pane_acquire(int pane){
+  pthread_mutex_lock(&tym_i_lock);
+  if(tym_i_binit != INIT_STATE_INITIALISED){
+    errno = EINVAL;
+    goto error;
+  }
+  struct tym_i_pane_internal* ppane = tym_i_pane_get(pane);
+  if(!ppane){
+    errno = ENOENT;
+    goto error;
+  }
+  ppane->refcount++;
+  pthread_mutex_unlock(&tym_i_lock);
+  pthread_mutex_lock(&ppane->lock);
+  if(ppane->destroyed){
+    tym_i_pane_release(ppane);
+    errno = ENOENT;
+    return 0;
+  }
+  return ppane;
+error:
+  pthread_mutex_unlock(&tym_i_lock);
+  return 0;
+}
+
+/** Unlock a pane acquired using tym_i_pane_acquire */
+void tym_i_pane_release(struct tym_i_pane_internal* pane){
+  pthread_mutex_unlock(&pane->lock);
+  pthread_mutex_lock(&tym_i_lock);
+  tym_i_pane_unref(pane);
+  pthread_mutex_unlock(&tym_i_lock);
+}
+
+/** Drop a reference to a pane, and free it if it was the last one. tym_i_lock must be held. */
+void tym_i_pane_unref(struct tym_i_pane_internal* pane){
+  if(--pane->refcount)
+    return;
+  pthread_mutex_destroy(&pane->lock);
+  free(pane->stats.sequence);
+  free(pane->title);
+  free(pane->title_pending);
+  free(pane);
+}
+
+/**
+ * Update tym_i_pane_internal::focus of a pane to match tym_i_focus_pane, and draw the cursor if it got the focus.
+ * tym_i_focus_pane may have changed again in the meantime, so the state is taken from it instead of the caller.
+ */
+static void pane_focus_update(struct tym_i_pane_internal* pane){
+  pthread_mutex_lock(&pane->lock);
+  bool focus = __atomic_load_n(&tym_i_focus_pane, __ATOMIC_ACQUIRE) == pane;
+  if(pane->destroyed || pane->focus == focus){
+    pthread_mutex_unlock(&pane->lock);
+    return;
+  }
+  pane->focus = focus;
+  if(focus){
+    tym_i_pane_update_cursor(pane);
+    pthread_mutex_lock(&tym_i_backend_lock);
+    if(tym_i_worker_count)
+      tym_i_backend->pane_set_cursor_position(pane, pane->damage.cursor_position);
+    tym_i_backend->pane_refresh(pane);
+    pthread_mutex_unlock(&tym_i_backend_lock);
+  }
+  pthread_mutex_unlock(&pane->lock);
+}
+
+/**
+ * Set the focus on a pane. This will set tym_i_focus_pane. tym_i_lock must be held.
+ * It's released while the panes losing and getting the focus are updated,
+ * so a busy pane doesn't hold up anything concerning other panes.
+ */
 int tym_i_pane_focus(struct tym_i_pane_internal* pane){
   if(pane){
     if(pane->nofocus){
@@ -110,21 +203,46 @@ int tym_i_pane_focus(struct tym_i_pane_internal* pane){
     }
     if(tym_i_focus_pane == pane)
       return 0;
-    tym_i_focus_pane = pane;
-    tym_i_pane_update_cursor(pane);
-    tym_i_backend->pane_refresh(pane);
-  }else{
-    tym_i_focus_pane = 0;
   }
+  struct tym_i_pane_internal* previous = tym_i_focus_pane;
+  __atomic_store_n(&tym_i_focus_pane, pane, __ATOMIC_RELEASE);
+  if(previous)
+    previous->refcount++;
+  if(pane)
+    pane->refcount++;
+  pthread_mutex_unlock(&tym_i_lock);
+  if(previous)
+    pane_focus_update(previous);
+  if(pane)
+    pane_focus_update(pane);
+  pthread_mutex_lock(&tym_i_lock);
+  if(previous)
+    tym_i_pane_unref(previous);
+  if(pane)
+    tym_i_pane_unref(pane);
   return 0;
 }
 
 /** Update the visible cursor position. This is only done for the pane in focus, the other panes don't have a vidible cursor. */
 void tym_i_pane_update_cursor(struct tym_i_pane_internal* pane){
-  if(pane != tym_i_focus_pane || !pane)
+  if(!pane || !pane->focus)
     return;
   struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
-  tym_i_backend->pane_set_cursor_position(pane, screen->cursor);
+  struct tym_i_cell_position cursor = screen->cursor;
+  unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
+  // After a character was written to the last column, the cursor is one past it until the next character wraps around.
+  if(w && cursor.x >= w)
+    cursor.x = w - 1;
+  if(cursor.x != pane->damage.cursor_position.x || cursor.y != pane->damage.cursor_position.y){
+    pane->damage.cursor_position = cursor;
+    pane->damage.cursor = true;
+  }
+  // The workers don't draw anything, the cursor is placed when the pane is rendered
+  if(tym_i_worker_count)
+    return;
+  pthread_mutex_lock(&tym_i_backend_lock);
+  tym_i_backend->pane_set_cursor_position(pane, cursor);
+  pthread_mutex_unlock(&tym_i_backend_lock);
 }
 
 /**
@@ -133,8 +251,11 @@ void tym_i_pane_update_cursor(struct tym_i_pane_internal* pane){
  * \see tym_pane_destroy
  */
 void tym_i_pane_remove(struct tym_i_pane_internal* pane){
-  if(tym_i_focus_pane == pane)
-    tym_i_pane_focus(0);
+  // The lock of the pane is already held, tym_i_pane_focus would wait for it without tym_i_lock
+  if(tym_i_focus_pane == pane){
+    __atomic_store_n(&tym_i_focus_pane, 0, __ATOMIC_RELEASE);
+    pane->focus = false;
+  }
   if(tym_i_pane_list_start == pane)
     tym_i_pane_list_start = pane->next;
   if(tym_i_pane_list_end == pane)
@@ -145,20 +266,130 @@ void tym_i_pane_remove(struct tym_i_pane_internal* pane){
     pane->next->previous = pane->previous;
 }
 
+/**
+ * Read & parse the pending output of a pane, as far as its budget allows.
+ * Every call adds tym_i_read_quantum bytes to the budget of the pane, budget which isn't used
+ * is kept for the next time, up to tym_i_read_budget_max bytes. A pane flooded with output
+ * can only read the quantum every time it's its turn, while a pane with occasional output
+ * can catch up on a burst at once. The lock of the pane has to be held.
+ * Returns the number of bytes read, or -1 if reading failed. errno is EAGAIN if there was nothing to read.
+ */
+ssize_t tym_i_pane_read(struct tym_i_pane_internal* pane){
+  char buf[TYM_I_READ_SIZE];
+  size_t total = 0;
+  pane->budget += tym_i_read_quantum;
+  if(pane->budget > tym_i_read_budget_max)
+    pane->budget = tym_i_read_budget_max;
+  while(pane->budget){
+    ssize_t ret;
+    uint64_t start = tym_i_trace_begin();
+    do {
+      ret = read(pane->master, buf, pane->budget < sizeof(buf) ? pane->budget : sizeof(buf));
+    } while(ret == -1 && errno == EINTR);
+    tym_i_trace_end(pane, TYM_I_TRACE_READ, start);
+    if(ret == -1 && !total)
+      return -1;
+    if(ret <= 0)
+      break;
+    pane->stats.reads++;
+    pane->stats.bytes_read += ret;
+    start = tym_i_trace_begin();
+    uint64_t parse_start = tym_i_trace_now();
+    tym_i_pane_parse_buffer(pane, buf, ret);
+    pane->stats.parse_time += tym_i_trace_now() - parse_start;
+    tym_i_trace_end(pane, TYM_I_TRACE_PARSE, start);
+    total += ret;
+    pane->budget -= ret;
+    pane->unrendered += ret;
+    // Only read again if that won't block
+    int available = 0;
+    if(ioctl(pane->master, FIONREAD, &available) == -1 || available <= 0)
+      break;
+  }
+  return total;
+}
+
+/**
+ * Stop watching the master of a pane while more than tym_i_unrendered_limit bytes of its output
+ * haven't been rendered yet, and continue once they have. If the backend can't keep up, this
+ * leaves the output in the pseudo terminal, which makes the program writing it wait,
+ * instead of parsing output which will be overwritten before it's ever shown. tym_i_lock has to be held.
+ */
+void tym_i_pane_flow_control(struct tym_i_pane_internal* pane){
+  if(pane->destroyed)
+    return;
+  pthread_mutex_lock(&pane->lock);
+  bool throttle = tym_i_unrendered_limit && pane->unrendered >= tym_i_unrendered_limit;
+  pthread_mutex_unlock(&pane->lock);
+  if(throttle == pane->throttled)
+    return;
+  if(tym_i_pollfd_pause(pane->master, throttle) == -1){
+    TYM_U_PERROR(TYM_LOG_WARN, "tym_i_pollfd_pause failed");
+    return;
+  }
+  pane->throttled = throttle;
+}
+
+/**
+ * Write the queued data of a pane, see tym_i_pts_send. Once nothing is queued anymore,
+ * or it can't be written anymore, the master isn't watched for POLLOUT anymore.
+ */
+static void pane_ptm_flush(struct tym_i_pane_internal* pane){
+  pthread_mutex_lock(&pane->lock);
+  int ret = tym_i_pts_flush(pane);
+  if(ret == -1){
+    TYM_U_PERROR(TYM_LOG_WARN, "write failed, discarding the data queued for the pane");
+    tym_i_pts_discard(pane);
+  }
+  pthread_mutex_unlock(&pane->lock);
+  if(ret != 1 && tym_i_pollfd_watch_output(pane->master, false) == -1)
+    TYM_U_PERROR(TYM_LOG_ERROR, "tym_i_pollfd_watch_output failed");
+}
+
+/**
+ * Read & parse the output of a pane.
+ * The main loop calls this with tym_i_lock held once. It's released while the pane is parsed,
+ * so that other threads can use the library in the meantime. The pane may get destroyed while
+ * the lock is released, the reference taken here makes sure it isn't freed before this returns.
+ * If there are workers, the pane is just passed on to them, see tym_i_worker_enqueue.
+ * If the master became writable, the data queued for the pane is written first, see pane_ptm_flush.
+ */
 static int pane_ptm_input_handler(void* ptr, short event, int fd){
-  if(!(event & POLLIN))
+  if(!(event & (POLLIN|POLLOUT)))
     return -1;
   struct tym_i_pane_internal* pane = ptr;
-  static char buf[256];
-  ssize_t ret;
-  do {
-    ret = read(fd, buf, sizeof(buf));
-  } while(ret == -1 && errno == EINTR);
-  if(ret == -1)
+  if(event & POLLOUT)
+    pane_ptm_flush(pane);
+  if(!(event & POLLIN)){
+    if(tym_i_worker_count && tym_i_pollfd_rearm(fd) == -1)
+      TYM_U_PERROR(TYM_LOG_ERROR, "tym_i_pollfd_rearm failed");
+    return 0;
+  }
+  if(tym_i_worker_count){
+    tym_i_worker_enqueue(pane);
+    return 0;
+  }
+  ssize_t ret = 0;
+  int err = 0;
+  pane->refcount++;
+  pthread_mutex_unlock(&tym_i_lock);
+  pthread_mutex_lock(&pane->lock);
+  if(!pane->destroyed){
+    ret = tym_i_pane_read(pane);
+    err = errno;
+  }
+  pthread_mutex_unlock(&pane->lock);
+  pthread_mutex_lock(&tym_i_lock);
+  bool destroyed = pane->destroyed;
+  tym_i_pane_unref(pane);
+  if(destroyed)
+    return 0;
+  if(ret == -1 && err != EAGAIN)
     return -1;
-  for(size_t i=0; i<(size_t)ret; i++)
-    tym_i_pane_parse(pane, buf[i]);
-  tym_i_backend->pane_refresh(pane);
+  if(ret == -1)
+    ret = 0;
+  tym_i_render_schedule(pane, ret);
+  tym_i_pane_flow_control(pane);
   return 0;
 }
 
@@ -233,10 +464,18 @@ int tym_pane_create(const struct tym_super_position_rectangle*restrict super_pos
         [VWERASE]  =  027,
 #endif
       }
-    },
-    .sequence.seq_opt_max = -1
+    }
   };
   struct tym_i_pane_internal* pane = tym_i_copy(sizeof(hpane), &hpane);
+  if(!pane)
+    goto error;
+  pane->stats.sequence = calloc(tym_i_command_sequence_map_count, sizeof(*pane->stats.sequence));
+  if(!pane->stats.sequence){
+    free(pane);
+    goto error;
+  }
+  pthread_mutex_init(&pane->lock, &tym_i_lock_attr);
+  pane->refcount = 1;
   pane->super_position = *super_position;
   tym_i_calc_rectangle_absolut_position(&pane->absolute_position, &pane->super_position);
   unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
@@ -248,14 +487,19 @@ int tym_pane_create(const struct tym_super_position_rectangle*restrict super_pos
   int ret = openpty(&pane->master, &pane->slave, 0, &pane->termios, &size);
   if(ret)
     goto error;
-  fcntl(pane->master, F_SETFD, FD_CLOEXEC | O_NONBLOCK);
+  fcntl(pane->master, F_SETFD, FD_CLOEXEC);
+  fcntl(pane->master, F_SETFL, fcntl(pane->master, F_GETFL) | O_NONBLOCK);
   fcntl(pane->slave, F_SETFD, FD_CLOEXEC);
-  if(tym_i_backend->pane_create(pane) != 0)
+  pthread_mutex_lock(&tym_i_backend_lock);
+  ret = tym_i_backend->pane_create(pane);
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  if(ret != 0)
     goto error;
   tym_i_pane_add(pane);
   if(tym_i_pollfd_add(pane->master, &(struct tym_i_pollfd_complement){
     .ptr = pane,
-    .onevent = pane_ptm_input_handler
+    .onevent = pane_ptm_input_handler,
+    .oneshot = tym_i_worker_count
   })) goto error;
   tym_i_pane_update_size(pane);
   pthread_mutex_unlock(&tym_i_lock);
@@ -276,12 +520,19 @@ int tym_pane_destroy(int pane){
     errno = ENOENT;
     goto error;
   }
-  tym_pane_reset(pane);
+  pthread_mutex_lock(&ppane->lock);
+  tym_i_pane_reset(ppane);
+  pthread_mutex_lock(&tym_i_backend_lock);
   tym_i_backend->pane_destroy(ppane);
+  pthread_mutex_unlock(&tym_i_backend_lock);
   tym_i_pollfd_remove(ppane->master);
   tym_i_pane_remove(ppane);
   close(ppane->slave);
-  free(ppane);
+  tym_i_screen_free(ppane);
+  tym_i_pts_discard(ppane);
+  ppane->destroyed = true;
+  pthread_mutex_unlock(&ppane->lock);
+  tym_i_pane_unref(ppane);
   pthread_mutex_unlock(&tym_i_lock);
   return 0;
 error:
@@ -401,23 +652,26 @@ int tym_i_pane_set_cursor_position(
 }
 
 int tym_pane_resize(int pane, const struct tym_super_position_rectangle*restrict super_position){
-  pthread_mutex_lock(&tym_i_lock);
-  if(tym_i_binit != INIT_STATE_INITIALISED){
-    errno = EINVAL;
-    goto error;
-  }
-  struct tym_i_pane_internal* ppane = tym_i_pane_get(pane);
-  if(!ppane){
-    errno = ENOENT;
-    goto error;
+  while(true){
+    // tym_i_bounds is protected by tym_i_lock, but the lock of the pane mustn't be waited for while holding it
+    pthread_mutex_lock(&tym_i_lock);
+    struct tym_absolute_position_rectangle absolute_position;
+    tym_i_calc_rectangle_absolut_position(&absolute_position, super_position);
+    unsigned generation = tym_i_bounds_generation;
+    pthread_mutex_unlock(&tym_i_lock);
+    struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+    if(!ppane)
+      return -1;
+    // If the size of the screen changed in the meantime, the position has to be calculated again
+    if((int)(ppane->bounds_generation - generation) > 0){
+      tym_i_pane_release(ppane);
+      continue;
+    }
+    ppane->super_position = *super_position;
+    pane_apply_size(ppane, &absolute_position, generation);
+    tym_i_pane_release(ppane);
+    return 0;
   }
-  ppane->super_position = *super_position;
-  tym_i_pane_update_size(ppane);
-  pthread_mutex_unlock(&tym_i_lock);
-  return 0;
-error:
-  pthread_mutex_unlock(&tym_i_lock);
-  return -1;
 }
 
 static const char* getTerm(void){
@@ -632,11 +886,28 @@ int tym_i_scroll_def_scrolling_region(struct tym_i_pane_internal* pane, unsigned
   unsigned h = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_VERTICAL);
   if(bottom > h)
     bottom = h;
-  if( top < bottom && !(top == 0 && bottom == h)){
-    return tym_i_backend->pane_scroll_region(pane, n, top, bottom);
+  bool region = top < bottom && !(top == 0 && bottom == h);
+  if(n)
+    pane->stats.scrolls++;
+  if(region){
+    tym_i_screen_scroll_region(pane, n, top, bottom);
+  }else{
+    tym_i_screen_scroll_region(pane, n, 0, h);
+  }
+  // The workers don't draw anything, the scroll is passed on when the pane is rendered
+  if(tym_i_worker_count){
+    tym_i_damage_scroll(pane, n, region ? top : 0, region ? bottom : h);
+    return 0;
+  }
+  pthread_mutex_lock(&tym_i_backend_lock);
+  int ret;
+  if(region){
+    ret = tym_i_backend->pane_scroll_region(pane, n, top, bottom);
   }else{
-    return tym_i_backend->pane_scroll(pane, n);
+    ret = tym_i_backend->pane_scroll(pane, n);
   }
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  return ret;
 }
 
 /** Scroll the current panes scrolling region. */
@@ -657,21 +928,33 @@ int tym_i_pane_insert_delete_lines(struct tym_i_pane_internal* pane, unsigned y,
 int tym_i_pane_set_screen(struct tym_i_pane_internal* pane, enum tym_i_pane_screen screen){
   enum tym_i_pane_screen old = pane->current_screen;
   pane->current_screen = screen;
+  pthread_mutex_lock(&tym_i_backend_lock);
   int res = tym_i_backend->pane_change_screen(pane);
+  pthread_mutex_unlock(&tym_i_backend_lock);
   if(res == -1)
     pane->current_screen = old;
+  // A pending scroll belongs to the previous screen
+  if(res != -1)
+    pane->damage.scroll = 0;
+  tym_i_damage_mark_all(pane);
   return res;
 }
 
 /** \see tym_pane_reset */
 int tym_i_pane_reset(struct tym_i_pane_internal* pane){
+  struct tym_i_cell_grid grid[TYM_I_SCREEN_COUNT];
+  for(size_t i=0; i<TYM_I_SCREEN_COUNT; i++)
+    grid[i] = pane->screen[i].grid;
   memset(pane->screen, 0, sizeof(pane->screen));
+  for(size_t i=0; i<TYM_I_SCREEN_COUNT; i++)
+    pane->screen[i].grid = grid[i];
   struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
   unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
   unsigned h = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_VERTICAL);
   pane->mouse_mode = TYM_I_MOUSE_MODE_OFF;
+  pane->bracketed_paste = false;
   pane->character.not_utf8 = false;
-  tym_i_backend->pane_erase_area(pane, (struct tym_i_cell_position){.x=0,.y=0}, (struct tym_i_cell_position){.x=w,.y=h}, false, screen->character_format);
+  tym_i_pane_erase_area(pane, (struct tym_i_cell_position){.x=0,.y=0}, (struct tym_i_cell_position){.x=w,.y=h}, false, screen->character_format);
   tym_i_pane_set_cursor_position( pane,
     TYM_I_SCP_PM_ORIGIN_RELATIVE, 0,
     TYM_I_SCP_SMM_NO_SCROLLING, TYM_I_SCP_PM_ORIGIN_RELATIVE, 0,
@@ -681,82 +964,48 @@ int tym_i_pane_reset(struct tym_i_pane_internal* pane){
 }
 
 int tym_pane_reset(int pane){
-  pthread_mutex_lock(&tym_i_lock);
-  if(tym_i_binit != INIT_STATE_INITIALISED){
-    errno = EINVAL;
-    goto error;
-  }
-  struct tym_i_pane_internal* ppane = tym_i_pane_get(pane);
-  if(!ppane){
-    errno = ENOENT;
-    goto error;
-  }
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane)
+    return -1;
   int ret = tym_i_pane_reset(ppane);
-  pthread_mutex_unlock(&tym_i_lock);
+  tym_i_pane_release(ppane);
   return ret;
-error:
-  pthread_mutex_unlock(&tym_i_lock);
-  return -1;
 }
 
 int tym_pane_send_key(int pane, uint_least16_t key){
-  int ret = 0;
-  pthread_mutex_lock(&tym_i_lock);
-  if(tym_i_binit != INIT_STATE_INITIALISED){
-    errno = EINVAL;
-    goto error;
-  }
-  struct tym_i_pane_internal* ppane = tym_i_pane_get(pane);
-  if(!ppane){
-    errno = ENOENT;
-    goto error;
-  }
-  ret = tym_i_pts_send_key(ppane, key);
-  pthread_mutex_unlock(&tym_i_lock);
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane)
+    return -1;
+  int ret = tym_i_pts_send_key(ppane, key);
+  tym_i_pane_release(ppane);
   return ret;
-error:
-  pthread_mutex_unlock(&tym_i_lock);
-  return -1;
 }
 
 int tym_pane_send_keys(int pane, size_t count, const uint_least16_t keys[count]){
-  int ret = 0;
-  pthread_mutex_lock(&tym_i_lock);
-  if(tym_i_binit != INIT_STATE_INITIALISED){
-    errno = EINVAL;
-    goto error;
-  }
-  struct tym_i_pane_internal* ppane = tym_i_pane_get(pane);
-  if(!ppane){
-    errno = ENOENT;
-    goto error;
-  }
-  ret = tym_i_pts_send_keys(ppane, count, keys);
-  pthread_mutex_unlock(&tym_i_lock);
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane)
+    return -1;
+  int ret = tym_i_pts_send_keys(ppane, count, keys);
+  tym_i_pane_release(ppane);
   return ret;
-error:
-  pthread_mutex_unlock(&tym_i_lock);
-  return -1;
 }
 
 int tym_pane_type(int pane, size_t count, const char keys[count]){
-  int ret = 0;
-  pthread_mutex_lock(&tym_i_lock);
-  if(tym_i_binit != INIT_STATE_INITIALISED){
-    errno = EINVAL;
-    goto error;
-  }
-  struct tym_i_pane_internal* ppane = tym_i_pane_get(pane);
-  if(!ppane){
-    errno = ENOENT;
-    goto error;
-  }
-  ret = tym_i_pts_type(ppane, count, keys);
-  pthread_mutex_unlock(&tym_i_lock);
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane)
+    return -1;
+  int ret = tym_i_pts_type(ppane, count, keys);
+  tym_i_pane_release(ppane);
+  return ret;
+}
+
+int tym_pane_paste(int pane, size_t size, const char data[size]){
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane)
+    return -1;
+  int ret = tym_i_pts_paste(ppane, size, data);
+  tym_i_pane_release(ppane);
   return ret;
-error:
-  pthread_mutex_unlock(&tym_i_lock);
-  return -1;
 }
 
 int tym_pane_send_special_key_by_name(int pane, const char* key_name){
@@ -775,27 +1024,64 @@ int tym_pane_send_special_key_by_name(int pane, const char* key_name){
 }
 
 int tym_pane_send_mouse_event(int pane, enum tym_button button, const struct tym_super_position*restrict position){
-  int ret = 0;
-  pthread_mutex_lock(&tym_i_lock);
-  if(tym_i_binit != INIT_STATE_INITIALISED){
-    errno = EINVAL;
-    goto error;
-  }
-  struct tym_i_pane_internal* ppane = tym_i_pane_get(pane);
-  if(!ppane){
-    errno = ENOENT;
-    goto error;
-  }
   struct tym_absolute_position pos;
+  pthread_mutex_lock(&tym_i_lock);
   tym_i_calc_absolut_position(&pos, &tym_i_bounds, position, true);
+  pthread_mutex_unlock(&tym_i_lock);
   struct tym_i_cell_position cell_position = {
     .x = TYM_POS_REF(pos, CHARFIELD, TYM_AXIS_VERTICAL),
     .y = TYM_POS_REF(pos, CHARFIELD, TYM_AXIS_HORIZONTAL),
   };
-  ret = tym_i_pts_send_mouse_event(ppane, button, cell_position);
-  pthread_mutex_unlock(&tym_i_lock);
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane)
+    return -1;
+  int ret = tym_i_pts_send_mouse_event(ppane, button, cell_position);
+  tym_i_pane_release(ppane);
   return ret;
-error:
-  pthread_mutex_unlock(&tym_i_lock);
-  return -1;
+}
+
+int tym_pane_get_stats(int pane, struct tym_pane_stats* stats){
+  if(!stats || (stats->sequence_count && !stats->sequence)){
+    errno = EINVAL;
+    return -1;
+  }
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane)
+    return -1;
+  const struct tym_i_pane_stats* s = &ppane->stats;
+  size_t count = stats->sequence_count < tym_i_command_sequence_map_count ? stats->sequence_count : tym_i_command_sequence_map_count;
+  if(count)
+    memcpy(stats->sequence, s->sequence, count * sizeof(*stats->sequence));
+  *stats = (struct tym_pane_stats){
+    .bytes_read = s->bytes_read,
+    .reads = s->reads,
+    .sequences_unknown = s->sequences_unknown,
+    .utf8_invalid = s->utf8_invalid,
+    .scrolls = s->scrolls,
+    .cells_written = s->cells_written,
+    .refreshes = s->refreshes,
+    .parse_time = s->parse_time,
+    .sequence_count = tym_i_command_sequence_map_count,
+    .sequence = stats->sequence,
+  };
+  tym_i_pane_release(ppane);
+  return 0;
+}
+
+int tym_pane_get_title(int pane, size_t size, char title[size]){
+  if(size && !title){
+    errno = EINVAL;
+    return -1;
+  }
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane)
+    return -1;
+  size_t length = ppane->title ? strlen(ppane->title) : 0;
+  if(size){
+    size_t n = length < size ? length : size - 1;
+    memcpy(title, ppane->title, n);
+    title[n] = 0;
+  }
+  tym_i_pane_release(ppane);
+  return length;
 }
@@ -23,9 +23,10 @@ int tym_pane_set_flag(int pane, enum tym_flag flag, bool state){
   switch(flag){
     case TYM_PF_FOCUS: ret = tym_i_pane_focus(ppane); break;
     case TYM_PF_DISALLOW_FOCUS: {
+      // tym_i_pane_focus releases tym_i_lock, the pane may be gone afterwards
+      ppane->nofocus = state;
       if(!state && tym_i_focus_pane == ppane)
         tym_i_pane_focus(0);
-      ppane->nofocus = state;
     } break;
   }
   pthread_mutex_unlock(&tym_i_lock);
@@ -36,6 +37,7 @@ error:
 }
 
 int tym_pane_get_flag(int pane, enum tym_flag flag){
+  int ret = 0;
   pthread_mutex_lock(&tym_i_lock);
   if(tym_i_binit != INIT_STATE_INITIALISED){
     errno = EINVAL;
@@ -47,11 +49,11 @@ int tym_pane_get_flag(int pane, enum tym_flag flag){
     goto error;
   }
   switch(flag){
-    case TYM_PF_FOCUS: return tym_i_focus_pane == ppane;
-    case TYM_PF_DISALLOW_FOCUS: return ppane->nofocus;
+    case TYM_PF_FOCUS: ret = tym_i_focus_pane == ppane; break;
+    case TYM_PF_DISALLOW_FOCUS: ret = ppane->nofocus; break;
   }
   pthread_mutex_unlock(&tym_i_lock);
-  return 0;
+  return ret;
 error:
   pthread_mutex_unlock(&tym_i_lock);
   return -1;
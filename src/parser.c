@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 
 #include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
@@ -11,6 +12,9 @@
 #include <internal/pane.h>
 #include <internal/backend.h>
 #include <internal/parser.h>
+#include <internal/profile.h>
+#include <internal/scan.h>
+#include <internal/screen.h>
 
 /** \file */
 
@@ -35,9 +39,15 @@
 
 /**
  * This is a list of all escape sequences and the corresponding callback function.
- * There is a limitation though: don't specify NUM and an actuall number in different
- * escape sequences with the same start, the parser isn't designed to handle that.
- * Same for SNUM, TEXT and similar macros.
+ * The templates have to have one of the following forms:
+ *  - ESC, intermediate characters, a final character or C, and optionally C for sequences taking the next character as argument
+ *  - CSI, an optional private marker, optionally NUM, intermediate characters, a final character
+ *  - OSC SNUM ";" TEXT, followed by ST or BEL
+ *  - DCS, SOS, PM or APC, followed by TEXT and ST
+ *
+ * In the templates, C stands for an arbitrary character, which is passed to the callback as the first integer.
+ * The TEXT of control strings isn't kept, it's passed to the tym_i_csq_string_callback of the entry while it's parsed.
+ * \see parse_template
  */
 #define CSQS \
   CSQ( RIS, reset ) \
@@ -143,9 +153,15 @@
   CSQ( CSI "?" NUM "h", enable ) \
   CSQ( CSI "?" NUM "l", disable ) \
   CSQ( OSC SNUM ";" TEXT ST, osc_cmd ) \
-  CSQ( OSC SNUM ";" TEXT "\7", osc_cmd )
+  CSQ( OSC SNUM ";" TEXT "\7", osc_cmd ) \
+  CSQ( DCS TEXT ST, device_control_string ) \
+  CSQ( SOS TEXT ST, start_of_string ) \
+  CSQ( PM TEXT ST, privacy_message ) \
+  CSQ( APC TEXT ST, application_program_command )
 
-#define CSQ(A,B) int tym_i_csq_ ## B(struct tym_i_pane_internal* pane) __attribute__((weak));
+#define CSQ(A,B) \
+  int tym_i_csq_ ## B(struct tym_i_pane_internal* pane) __attribute__((weak)); \
+  void tym_i_csq_ ## B ## _string(struct tym_i_pane_internal* pane, enum tym_i_string_event event, size_t size, const char data[size]) __attribute__((weak));
   CSQS
 #undef CSQ
 
@@ -153,50 +169,122 @@
     .sequence=(A), \
     .length=sizeof(A)-1, \
     .callback_name=(#B), \
-    .callback=tym_i_csq_ ## B \
+    .callback=tym_i_csq_ ## B, \
+    .string_callback=tym_i_csq_ ## B ## _string \
   },
 /**
- * This is an array of all escape sequences. This will be sorted using the 
- * using the command_sequence_comparator in the init function in this file.
+ * This is an array of all escape sequences. The init function in this file
+ * indexes them by their final character, see dispatch_head.
  */
-static struct tym_i_command_sequence tym_i_command_sequence_map[] = {
+static const struct tym_i_command_sequence tym_i_command_sequence_map[] = {
 CSQS
 };
 #undef CSQ
-static const size_t tym_i_command_sequence_map_count = sizeof(tym_i_command_sequence_map)/sizeof(*tym_i_command_sequence_map);
+const size_t tym_i_command_sequence_map_count = sizeof(tym_i_command_sequence_map)/sizeof(*tym_i_command_sequence_map);
 
-/** A comperator for characters in the escape sequence template. */
-static int command_sequence_comparator_ch(char ca, char cb){
-  if(ca == cb)
-    return 0;
-  if((ca < ' ') == (cb < ' '))
-    return (ca < cb) ? -1 : 1;
-  return ca < ' ' ? 1 : -1;
-}
+/** The different kinds of escape sequences */
+enum sequence_kind {
+  SK_ESC, //!< ESC followed by intermediate and final characters
+  SK_CSI, //!< Control sequences
+  SK_OSC, //!< Operating system commands
+  SK_STRING, //!< DCS, SOS, PM and APC strings, by the character following ESC
+  SK_COUNT
+};
 
-/** A comperator for escape sequences. */
-static int command_sequence_comparator_str(const char*restrict ia, const char*restrict ib){
-  for( ; *ia && *ib; ia++, ib++ ){
-    int ret = command_sequence_comparator_ch(*ia, *ib);
-    if(ret)
-      return ret;
-  }
-  if(*ia) return 1;
-  if(*ib) return -1;
-  return 0;
-}
+/** The parts of an escape sequence template relevant for finding its callback */
+struct sequence_key {
+  /** The kind of the escape sequence */
+  unsigned char kind;
+  /** The private marker of control sequences, or 0 */
+  char private_marker;
+  /** The number of intermediate characters */
+  unsigned char intermediate_count;
+  /** The intermediate characters */
+  char intermediate[TYM_I_MAX_INTERMEDIATE_COUNT];
+  /** The final character, or 0 if any character is allowed (C) */
+  unsigned char final;
+  /** If the control sequence has parameters (NUM) */
+  bool has_parameters;
+  /** If the escape sequence takes the character following its final character as argument (C) */
+  bool trailing_character;
+};
 
-/** same as command_sequence_comparator_str, wrapper for qsort. */
-static int command_sequence_comparator(const void*restrict pa, const void*restrict pb){
-  const struct tym_i_command_sequence* a = pa;
-  const struct tym_i_command_sequence* b = pb;
-  return command_sequence_comparator_str(a->sequence, b->sequence);
+/** The keys of the entries in tym_i_command_sequence_map */
+static struct sequence_key command_sequence_key[sizeof(tym_i_command_sequence_map)/sizeof(*tym_i_command_sequence_map)];
+/**
+ * The index of the first entry of tym_i_command_sequence_map for each kind of escape sequence and final character.
+ * Entries for escape sequences allowing any final character are at index 0. Unused entries are -1.
+ */
+static short dispatch_head[SK_COUNT][0x80];
+/** The index of the next entry with the same kind and final character as this one, or -1. */
+static short dispatch_next[sizeof(tym_i_command_sequence_map)/sizeof(*tym_i_command_sequence_map)];
+
+/**
+ * Parse an escape sequence template of tym_i_command_sequence_map.
+ * \see CSQS
+ */
+static bool parse_template(const struct tym_i_command_sequence* command, struct sequence_key* key){
+  const unsigned char* it = (const unsigned char*)command->sequence;
+  const unsigned char* end = it + command->length;
+  memset(key, 0, sizeof(*key));
+  if(it >= end || *it++ != '\x1B')
+    return false;
+  if(it < end && *it == '['){
+    key->kind = SK_CSI;
+    it++;
+    if(it < end && *it >= 0x3C && *it <= 0x3F)
+      key->private_marker = *it++;
+    if(it < end && *it == '\2'){
+      key->has_parameters = true;
+      it++;
+    }
+  }else if(it < end && *it == ']'){
+    key->kind = SK_OSC;
+    return true;
+  }else if(end - it >= 2 && *it && strchr("PX^_", *it) && it[1] == '\4'){
+    key->kind = SK_STRING;
+    key->final = *it;
+    return true;
+  }else{
+    key->kind = SK_ESC;
+  }
+  while(it < end && *it >= 0x20 && *it <= 0x2F){
+    if(key->intermediate_count >= TYM_I_MAX_INTERMEDIATE_COUNT)
+      return false;
+    key->intermediate[key->intermediate_count++] = *it++;
+  }
+  if(it >= end)
+    return false;
+  if(*it == '\1' && key->kind == SK_ESC){
+    key->final = 0;
+  }else if(*it >= (key->kind == SK_CSI ? 0x40 : 0x30) && *it <= 0x7E){
+    key->final = *it;
+  }else{
+    return false;
+  }
+  it++;
+  if(it < end && *it == '\1' && key->kind == SK_ESC && key->final){
+    key->trailing_character = true;
+    it++;
+  }
+  return it == end;
 }
 
 static void init(void) __attribute__((constructor,used));
 static void init(void){
-  qsort(tym_i_command_sequence_map, tym_i_command_sequence_map_count, sizeof(*tym_i_command_sequence_map), command_sequence_comparator);
   bool notice_printed = false;
+  for(size_t i=0; i<SK_COUNT; i++)
+    for(size_t j=0; j<0x80; j++)
+      dispatch_head[i][j] = -1;
+  for(size_t i=tym_i_command_sequence_map_count; i--; ){
+    struct sequence_key* key = &command_sequence_key[i];
+    if(!parse_template(&tym_i_command_sequence_map[i], key)){
+      TYM_U_LOG(TYM_LOG_ERROR, "Invalid escape sequence template for %s\n", tym_i_command_sequence_map[i].callback_name);
+      continue;
+    }
+    dispatch_next[i] = dispatch_head[key->kind][key->final];
+    dispatch_head[key->kind][key->final] = i;
+  }
   for(size_t i=0; i<tym_i_command_sequence_map_count; i++){
     if(tym_i_command_sequence_map[i].callback)
       continue;
@@ -208,31 +296,327 @@ static void init(void){
   }
 }
 
-enum specialmatch_result {
-  SM_NO_MATCH,
-  SM_MATCH_SINGLE,
-  SM_MATCH_CONTINUE
-};
-
-/** Handle special constants in the escape sequence template which could stand for multiple different characters. */
-static enum specialmatch_result specialmatch(unsigned char a, unsigned char b){
-  switch(a){
-    case '\1' /* C */: return SM_MATCH_SINGLE;
-    case '\2' /* SNUM */: return (b >= '0' && b <= '9') || b == ';' ? SM_MATCH_CONTINUE : SM_NO_MATCH;
-    case '\3' /* NUM  */: return (b >= '0' && b <= '9') ? SM_MATCH_CONTINUE : SM_NO_MATCH;
-    case '\4' /* TEXT */: return b >= ' ' ? SM_MATCH_CONTINUE : SM_NO_MATCH;
-    default: return SM_NO_MATCH;
+/** Find the entry of tym_i_command_sequence_map matching the escape sequence which ended with character c. Returns -1 if there is none. */
+static short lookup_sequence(enum sequence_kind kind, const struct tym_i_sequence_state* sequence, unsigned char c){
+  short head[] = { c < 0x80 && c ? dispatch_head[kind][c] : -1, dispatch_head[kind][0] };
+  for(size_t h=0; h<sizeof(head)/sizeof(*head); h++){
+    for(short i=head[h]; i != -1; i=dispatch_next[i]){
+      const struct sequence_key* key = &command_sequence_key[i];
+      if(kind == SK_OSC || kind == SK_STRING)
+        return i;
+      if( key->private_marker != sequence->private_marker
+       || key->intermediate_count != sequence->intermediate_count
+       || memcmp(key->intermediate, sequence->intermediate, key->intermediate_count)
+      ) continue;
+      if(kind == SK_CSI && key->has_parameters != !!sequence->integer_count)
+        continue;
+      return i;
+    }
   }
+  return -1;
+}
+
+const char* tym_sequence_name(size_t index){
+  if(index >= tym_i_command_sequence_map_count)
+    return 0;
+  return tym_i_command_sequence_map[index].callback_name;
 }
 
+/** The character classes used by the parser */
+enum parser_character_class {
+  PC_C0, //!< Control characters, except for the ones below
+  PC_BEL, //!< BEL, terminates operating system commands
+  PC_CANCEL, //!< CAN and SUB, these abort any escape sequence
+  PC_ESC, //!< ESC
+  PC_INTERMEDIATE, //!< 0x20-0x2F
+  PC_DIGIT, //!< 0-9
+  PC_COLON, //!< ':'
+  PC_SEMICOLON, //!< ';'
+  PC_PRIVATE_MARKER, //!< 0x3C-0x3F
+  PC_CSI, //!< '[', ESC [ is CSI
+  PC_OSC, //!< ']', ESC ] is OSC
+  PC_STRING, //!< 'P', 'X', '^' and '_'. ESC followed by these start DCS, SOS, PM and APC strings
+  PC_ST, //!< '\\', ESC \ is ST
+  PC_FINAL, //!< All other characters from 0x40-0x7E
+  PC_DEL, //!< DEL
+  PC_HIGH, //!< 0x80-0xFF, these are part of utf-8 characters
+  PC_COUNT
+};
+
+#define CHARACTER_CLASS(C) ( \
+    (C) == 0x07 ? PC_BEL \
+  : (C) == 0x18 || (C) == 0x1A ? PC_CANCEL \
+  : (C) == 0x1B ? PC_ESC \
+  : (C) < 0x20 ? PC_C0 \
+  : (C) < 0x30 ? PC_INTERMEDIATE \
+  : (C) < 0x3A ? PC_DIGIT \
+  : (C) == ':' ? PC_COLON \
+  : (C) == ';' ? PC_SEMICOLON \
+  : (C) < 0x40 ? PC_PRIVATE_MARKER \
+  : (C) == '[' ? PC_CSI \
+  : (C) == ']' ? PC_OSC \
+  : (C) == 'P' || (C) == 'X' || (C) == '^' || (C) == '_' ? PC_STRING \
+  : (C) == '\\' ? PC_ST \
+  : (C) < 0x7F ? PC_FINAL \
+  : (C) == 0x7F ? PC_DEL \
+  : PC_HIGH \
+)
+#define CC4(C) CHARACTER_CLASS(C), CHARACTER_CLASS(C+1), CHARACTER_CLASS(C+2), CHARACTER_CLASS(C+3)
+#define CC16(C) CC4(C), CC4(C+4), CC4(C+8), CC4(C+12)
+/** The character class of every byte */
+static const unsigned char character_class[256] = {
+  CC16(0x00), CC16(0x10), CC16(0x20), CC16(0x30), CC16(0x40), CC16(0x50), CC16(0x60), CC16(0x70),
+  CC16(0x80), CC16(0x90), CC16(0xA0), CC16(0xB0), CC16(0xC0), CC16(0xD0), CC16(0xE0), CC16(0xF0),
+};
+#undef CC16
+#undef CC4
+#undef CHARACTER_CLASS
+
+/** The actions of the parser */
+enum parser_action {
+  PA_NONE, //!< Ignore the character
+  PA_PRINT, //!< Print the character
+  PA_EXECUTE, //!< Interpret a control character
+  PA_COLLECT, //!< Add a private marker or an intermediate character
+  PA_PARAMETER, //!< Add a digit or separator to the integer arguments
+  PA_ESC_DISPATCH, //!< The final character of an ESC sequence
+  PA_CSI_DISPATCH, //!< The final character of a control sequence
+  PA_CHARACTER, //!< The character an escape sequence takes as argument. \see TYM_I_PS_ESCAPE_CHARACTER
+  PA_STRING_START, //!< The start of a control string, after ESC
+  PA_STRING_PUT, //!< A character of a control string
+  PA_STRING_DISPATCH, //!< The end of a control string
+  PA_STRING_ABORT, //!< A control string was aborted by CAN or SUB
+  PA_UNKNOWN, //!< The end of a malformed escape sequence
+};
+
+/** Don't change the state */
+#define PS_STAY 0xFF
+
+/** An entry of the transition table */
+struct parser_transition {
+  /** What to do with the character */
+  unsigned char action;
+  /** The new state. Entering TYM_I_PS_ESCAPE, TYM_I_PS_CSI_ENTRY, TYM_I_PS_OSC_STRING or TYM_I_PS_STRING resets the sequence state. */
+  unsigned char state;
+};
+
+#define T(ACTION, STATE) { .action = PA_ ## ACTION, .state = STATE }
+#define GROUND TYM_I_PS_GROUND
+#define ESCAPE TYM_I_PS_ESCAPE
+#define ESCAPE_INTERMEDIATE TYM_I_PS_ESCAPE_INTERMEDIATE
+#define CSI_ENTRY TYM_I_PS_CSI_ENTRY
+#define CSI_PARAM TYM_I_PS_CSI_PARAM
+#define CSI_INTERMEDIATE TYM_I_PS_CSI_INTERMEDIATE
+#define CSI_IGNORE TYM_I_PS_CSI_IGNORE
+#define OSC_STRING TYM_I_PS_OSC_STRING
+#define STRING TYM_I_PS_STRING
+/**
+ * The state transition table of the parser.
+ * For every character, its class is looked up in character_class,
+ * and the action to take and the next state are looked up here.
+ * Control characters in the middle of escape sequences are executed,
+ * CAN and SUB abort them and ESC starts a new one.
+ */
+static const struct parser_transition transition_table[TYM_I_PARSER_STATE_COUNT][PC_COUNT] = {
+  [TYM_I_PS_GROUND] = {
+    [PC_C0]             = T(EXECUTE, PS_STAY),
+    [PC_BEL]            = T(EXECUTE, PS_STAY),
+    [PC_CANCEL]         = T(EXECUTE, PS_STAY),
+    [PC_ESC]            = T(NONE, ESCAPE),
+    [PC_INTERMEDIATE]   = T(PRINT, PS_STAY),
+    [PC_DIGIT]          = T(PRINT, PS_STAY),
+    [PC_COLON]          = T(PRINT, PS_STAY),
+    [PC_SEMICOLON]      = T(PRINT, PS_STAY),
+    [PC_PRIVATE_MARKER] = T(PRINT, PS_STAY),
+    [PC_CSI]            = T(PRINT, PS_STAY),
+    [PC_OSC]            = T(PRINT, PS_STAY),
+    [PC_STRING]         = T(PRINT, PS_STAY),
+    [PC_ST]             = T(PRINT, PS_STAY),
+    [PC_FINAL]          = T(PRINT, PS_STAY),
+    [PC_DEL]            = T(EXECUTE, PS_STAY),
+    [PC_HIGH]           = T(PRINT, PS_STAY),
+  },
+  [TYM_I_PS_ESCAPE] = {
+    [PC_C0]             = T(EXECUTE, PS_STAY),
+    [PC_BEL]            = T(EXECUTE, PS_STAY),
+    [PC_CANCEL]         = T(NONE, GROUND),
+    [PC_ESC]            = T(NONE, ESCAPE),
+    [PC_INTERMEDIATE]   = T(COLLECT, ESCAPE_INTERMEDIATE),
+    [PC_DIGIT]          = T(ESC_DISPATCH, GROUND),
+    [PC_COLON]          = T(ESC_DISPATCH, GROUND),
+    [PC_SEMICOLON]      = T(ESC_DISPATCH, GROUND),
+    [PC_PRIVATE_MARKER] = T(ESC_DISPATCH, GROUND),
+    [PC_CSI]            = T(NONE, CSI_ENTRY),
+    [PC_OSC]            = T(STRING_START, OSC_STRING),
+    [PC_STRING]         = T(STRING_START, STRING),
+    [PC_ST]             = T(NONE, GROUND),
+    [PC_FINAL]          = T(ESC_DISPATCH, GROUND),
+    [PC_DEL]            = T(NONE, PS_STAY),
+    [PC_HIGH]           = T(ESC_DISPATCH, GROUND),
+  },
+  [TYM_I_PS_ESCAPE_INTERMEDIATE] = {
+    [PC_C0]             = T(EXECUTE, PS_STAY),
+    [PC_BEL]            = T(EXECUTE, PS_STAY),
+    [PC_CANCEL]         = T(NONE, GROUND),
+    [PC_ESC]            = T(NONE, ESCAPE),
+    [PC_INTERMEDIATE]   = T(COLLECT, PS_STAY),
+    [PC_DIGIT]          = T(ESC_DISPATCH, GROUND),
+    [PC_COLON]          = T(ESC_DISPATCH, GROUND),
+    [PC_SEMICOLON]      = T(ESC_DISPATCH, GROUND),
+    [PC_PRIVATE_MARKER] = T(ESC_DISPATCH, GROUND),
+    [PC_CSI]            = T(ESC_DISPATCH, GROUND),
+    [PC_OSC]            = T(ESC_DISPATCH, GROUND),
+    [PC_STRING]         = T(ESC_DISPATCH, GROUND),
+    [PC_ST]             = T(ESC_DISPATCH, GROUND),
+    [PC_FINAL]          = T(ESC_DISPATCH, GROUND),
+    [PC_DEL]            = T(NONE, PS_STAY),
+    [PC_HIGH]           = T(ESC_DISPATCH, GROUND),
+  },
+  [TYM_I_PS_ESCAPE_CHARACTER] = {
+    [PC_C0]             = T(CHARACTER, GROUND),
+    [PC_BEL]            = T(CHARACTER, GROUND),
+    [PC_CANCEL]         = T(CHARACTER, GROUND),
+    [PC_ESC]            = T(CHARACTER, GROUND),
+    [PC_INTERMEDIATE]   = T(CHARACTER, GROUND),
+    [PC_DIGIT]          = T(CHARACTER, GROUND),
+    [PC_COLON]          = T(CHARACTER, GROUND),
+    [PC_SEMICOLON]      = T(CHARACTER, GROUND),
+    [PC_PRIVATE_MARKER] = T(CHARACTER, GROUND),
+    [PC_CSI]            = T(CHARACTER, GROUND),
+    [PC_OSC]            = T(CHARACTER, GROUND),
+    [PC_STRING]         = T(CHARACTER, GROUND),
+    [PC_ST]             = T(CHARACTER, GROUND),
+    [PC_FINAL]          = T(CHARACTER, GROUND),
+    [PC_DEL]            = T(CHARACTER, GROUND),
+    [PC_HIGH]           = T(CHARACTER, GROUND),
+  },
+  [TYM_I_PS_CSI_ENTRY] = {
+    [PC_C0]             = T(EXECUTE, PS_STAY),
+    [PC_BEL]            = T(EXECUTE, PS_STAY),
+    [PC_CANCEL]         = T(NONE, GROUND),
+    [PC_ESC]            = T(NONE, ESCAPE),
+    [PC_INTERMEDIATE]   = T(COLLECT, CSI_INTERMEDIATE),
+    [PC_DIGIT]          = T(PARAMETER, CSI_PARAM),
+    [PC_COLON]          = T(NONE, CSI_IGNORE),
+    [PC_SEMICOLON]      = T(PARAMETER, CSI_PARAM),
+    [PC_PRIVATE_MARKER] = T(COLLECT, CSI_PARAM),
+    [PC_CSI]            = T(CSI_DISPATCH, GROUND),
+    [PC_OSC]            = T(CSI_DISPATCH, GROUND),
+    [PC_STRING]         = T(CSI_DISPATCH, GROUND),
+    [PC_ST]             = T(CSI_DISPATCH, GROUND),
+    [PC_FINAL]          = T(CSI_DISPATCH, GROUND),
+    [PC_DEL]            = T(NONE, PS_STAY),
+    [PC_HIGH]           = T(NONE, PS_STAY),
+  },
+  [TYM_I_PS_CSI_PARAM] = {
+    [PC_C0]             = T(EXECUTE, PS_STAY),
+    [PC_BEL]            = T(EXECUTE, PS_STAY),
+    [PC_CANCEL]         = T(NONE, GROUND),
+    [PC_ESC]            = T(NONE, ESCAPE),
+    [PC_INTERMEDIATE]   = T(COLLECT, CSI_INTERMEDIATE),
+    [PC_DIGIT]          = T(PARAMETER, PS_STAY),
+    [PC_COLON]          = T(NONE, CSI_IGNORE),
+    [PC_SEMICOLON]      = T(PARAMETER, PS_STAY),
+    [PC_PRIVATE_MARKER] = T(NONE, CSI_IGNORE),
+    [PC_CSI]            = T(CSI_DISPATCH, GROUND),
+    [PC_OSC]            = T(CSI_DISPATCH, GROUND),
+    [PC_STRING]         = T(CSI_DISPATCH, GROUND),
+    [PC_ST]             = T(CSI_DISPATCH, GROUND),
+    [PC_FINAL]          = T(CSI_DISPATCH, GROUND),
+    [PC_DEL]            = T(NONE, PS_STAY),
+    [PC_HIGH]           = T(NONE, PS_STAY),
+  },
+  [TYM_I_PS_CSI_INTERMEDIATE] = {
+    [PC_C0]             = T(EXECUTE, PS_STAY),
+    [PC_BEL]            = T(EXECUTE, PS_STAY),
+    [PC_CANCEL]         = T(NONE, GROUND),
+    [PC_ESC]            = T(NONE, ESCAPE),
+    [PC_INTERMEDIATE]   = T(COLLECT, PS_STAY),
+    [PC_DIGIT]          = T(NONE, CSI_IGNORE),
+    [PC_COLON]          = T(NONE, CSI_IGNORE),
+    [PC_SEMICOLON]      = T(NONE, CSI_IGNORE),
+    [PC_PRIVATE_MARKER] = T(NONE, CSI_IGNORE),
+    [PC_CSI]            = T(CSI_DISPATCH, GROUND),
+    [PC_OSC]            = T(CSI_DISPATCH, GROUND),
+    [PC_STRING]         = T(CSI_DISPATCH, GROUND),
+    [PC_ST]             = T(CSI_DISPATCH, GROUND),
+    [PC_FINAL]          = T(CSI_DISPATCH, GROUND),
+    [PC_DEL]            = T(NONE, PS_STAY),
+    [PC_HIGH]           = T(NONE, PS_STAY),
+  },
+  [TYM_I_PS_CSI_IGNORE] = {
+    [PC_C0]             = T(EXECUTE, PS_STAY),
+    [PC_BEL]            = T(EXECUTE, PS_STAY),
+    [PC_CANCEL]         = T(NONE, GROUND),
+    [PC_ESC]            = T(NONE, ESCAPE),
+    [PC_INTERMEDIATE]   = T(NONE, PS_STAY),
+    [PC_DIGIT]          = T(NONE, PS_STAY),
+    [PC_COLON]          = T(NONE, PS_STAY),
+    [PC_SEMICOLON]      = T(NONE, PS_STAY),
+    [PC_PRIVATE_MARKER] = T(NONE, PS_STAY),
+    [PC_CSI]            = T(UNKNOWN, GROUND),
+    [PC_OSC]            = T(UNKNOWN, GROUND),
+    [PC_STRING]         = T(UNKNOWN, GROUND),
+    [PC_ST]             = T(UNKNOWN, GROUND),
+    [PC_FINAL]          = T(UNKNOWN, GROUND),
+    [PC_DEL]            = T(NONE, PS_STAY),
+    [PC_HIGH]           = T(NONE, PS_STAY),
+  },
+  [TYM_I_PS_OSC_STRING] = {
+    [PC_C0]             = T(NONE, PS_STAY),
+    [PC_BEL]            = T(STRING_DISPATCH, GROUND),
+    [PC_CANCEL]         = T(STRING_ABORT, GROUND),
+    [PC_ESC]            = T(STRING_DISPATCH, ESCAPE),
+    [PC_INTERMEDIATE]   = T(STRING_PUT, PS_STAY),
+    [PC_DIGIT]          = T(STRING_PUT, PS_STAY),
+    [PC_COLON]          = T(STRING_PUT, PS_STAY),
+    [PC_SEMICOLON]      = T(STRING_PUT, PS_STAY),
+    [PC_PRIVATE_MARKER] = T(STRING_PUT, PS_STAY),
+    [PC_CSI]            = T(STRING_PUT, PS_STAY),
+    [PC_OSC]            = T(STRING_PUT, PS_STAY),
+    [PC_STRING]         = T(STRING_PUT, PS_STAY),
+    [PC_ST]             = T(STRING_PUT, PS_STAY),
+    [PC_FINAL]          = T(STRING_PUT, PS_STAY),
+    [PC_DEL]            = T(NONE, PS_STAY),
+    [PC_HIGH]           = T(STRING_PUT, PS_STAY),
+  },
+  [TYM_I_PS_STRING] = {
+    [PC_C0]             = T(STRING_PUT, PS_STAY),
+    [PC_BEL]            = T(STRING_PUT, PS_STAY),
+    [PC_CANCEL]         = T(STRING_ABORT, GROUND),
+    [PC_ESC]            = T(STRING_DISPATCH, ESCAPE),
+    [PC_INTERMEDIATE]   = T(STRING_PUT, PS_STAY),
+    [PC_DIGIT]          = T(STRING_PUT, PS_STAY),
+    [PC_COLON]          = T(STRING_PUT, PS_STAY),
+    [PC_SEMICOLON]      = T(STRING_PUT, PS_STAY),
+    [PC_PRIVATE_MARKER] = T(STRING_PUT, PS_STAY),
+    [PC_CSI]            = T(STRING_PUT, PS_STAY),
+    [PC_OSC]            = T(STRING_PUT, PS_STAY),
+    [PC_STRING]         = T(STRING_PUT, PS_STAY),
+    [PC_ST]             = T(STRING_PUT, PS_STAY),
+    [PC_FINAL]          = T(STRING_PUT, PS_STAY),
+    [PC_DEL]            = T(NONE, PS_STAY),
+    [PC_HIGH]           = T(STRING_PUT, PS_STAY),
+  },
+};
+#undef GROUND
+#undef ESCAPE
+#undef ESCAPE_INTERMEDIATE
+#undef CSI_ENTRY
+#undef CSI_PARAM
+#undef CSI_INTERMEDIATE
+#undef CSI_IGNORE
+#undef OSC_STRING
+#undef STRING
+#undef T
+
 /** Reset the parser state for the current sequence */
 static void reset_sequence(struct tym_i_sequence_state* sequence){
-  sequence->last_special_match_continue = false;
-  sequence->seq_opt_min = 0;
-  sequence->seq_opt_max = -1;
-  sequence->length = 0;
-  sequence->index = 0;
+  sequence->private_marker = 0;
+  sequence->intermediate_count = 0;
+  sequence->string_started = false;
   sequence->integer_count = 0;
+  sequence->command = 0;
   memset(sequence->integer, 0, sizeof(int) * TYM_I_MAX_INT_COUNT);
 }
 
@@ -322,7 +706,7 @@ void tym_i_print_character(struct tym_i_pane_internal* pane, const struct tym_i_
   );
   if(sequence){
     pane->last_character = character;
-    tym_i_backend->pane_set_character(pane, (struct tym_i_cell_position){x<w?x:w-1,y<h?y:h-1}, screen->character_format, strlen(sequence), sequence, screen->insert_mode);
+    tym_i_pane_set_character(pane, (struct tym_i_cell_position){x<w?x:w-1,y<h?y:h-1}, screen->character_format, strlen(sequence), sequence, screen->insert_mode);
   }
 }
 
@@ -331,12 +715,15 @@ static bool print_character_update(struct tym_i_pane_internal* pane, char c){
   if(tym_i_character_is_utf8(pane->character)){
     enum tym_i_utf8_character_state_push_result result = tym_i_utf8_character_state_push(&pane->character.data.utf8, c);
     if(result & TYM_I_UCS_INVALID_ABORT_FLAG){
+      pane->stats.utf8_invalid++;
       tym_i_print_character(pane, UTF8_INVALID_SYMBOL);
       memset(&pane->character.data.utf8, 0, sizeof(pane->character.data.utf8));
       return false;
     }else if(result == TYM_I_UCS_DONE){
       tym_i_print_character(pane, pane->character);
       memset(&pane->character.data.utf8, 0, sizeof(pane->character.data.utf8));
+    }else if(result == TYM_I_UCS_BROKEN_IGNORE || result == TYM_I_UCS_INVALID_ABORT){
+      pane->stats.utf8_invalid++;
     }
   }else{
     pane->character.data.byte = c;
@@ -345,6 +732,92 @@ static bool print_character_update(struct tym_i_pane_internal* pane, char c){
   return true;
 }
 
+/**
+ * Check if a byte would be printed if no escape sequence is in progress.
+ * Bytes belonging to utf-8 characters are printable too.
+ */
+static inline bool is_printable(unsigned char c){
+  return c >= ' ' && c != 0x7F;
+}
+
+/**
+ * Print a run of bytes for which is_printable is true.
+ * This is equivalent to passing them to tym_i_pane_parse one at a time
+ * if no escape sequence is in progress, but skips the escape sequence matching entirely.
+ */
+static void print_span(struct tym_i_pane_internal* pane, size_t length, const unsigned char span[length]){
+  for(size_t i=0; i<length; i++){
+    unsigned char c = span[i];
+    if(tym_i_character_is_utf8(pane->character))
+      if( pane->character.data.utf8.count )
+        if(print_character_update(pane, c))
+          continue;
+    if(tym_i_nocsq_test_hook)
+      tym_i_nocsq_test_hook(pane, c);
+    print_character_update(pane, c);
+  }
+  tym_i_pane_update_cursor(pane);
+}
+
+/**
+ * Print a run of printable ascii characters. With the utf-8 character set, these
+ * don't need to be translated, and since every one of them takes up a single cell,
+ * the cursor only needs to be moved once for every line the run ends up on.
+ * This has the same effect as passing the characters to print_span.
+ */
+static void print_ascii_span(struct tym_i_pane_internal* pane, size_t length, const unsigned char span[length]){
+  struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
+  unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
+  unsigned h = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_VERTICAL);
+  if(!w || !h || !length){
+    print_span(pane, length, span);
+    return;
+  }
+  while(length){
+    unsigned y = screen->cursor.y;
+    unsigned x = screen->cursor.x;
+    if(x >= w)
+      x = w;
+    if(y >= h)
+      y = h;
+    if(x >= w){
+      x = 0;
+      if(!screen->wraparound_mode_off)
+        y += 1;
+    }
+    size_t n = w - x;
+    if(n > length)
+      n = length;
+    tym_i_pane_set_cursor_position( pane,
+      TYM_I_SCP_PM_ABSOLUTE, x+n,
+      TYM_I_SCP_SMM_SCROLL_FORWARD_ONLY, TYM_I_SCP_PM_ABSOLUTE, y,
+      TYM_I_SCP_SCROLLING_REGION_UNCROSSABLE, true
+    );
+    struct tym_i_cell_position position = { .x = x, .y = y<h?y:h-1 };
+    if(tym_i_nocsq_test_hook)
+      for(size_t i=0; i<n; i++)
+        tym_i_nocsq_test_hook(pane, span[i]);
+    if(screen->insert_mode){
+      char character[2] = {0};
+      for(size_t i=0; i<n; i++, position.x++){
+        character[0] = span[i];
+        tym_i_pane_set_character(pane, position, screen->character_format, 1, character, true);
+      }
+    }else{
+      // The whole part of the run on this row has the same format, pass it to the backend at once
+      tym_i_pane_set_text_run(pane, position, screen->character_format, n, n, (const char*)span);
+    }
+    span += n;
+    length -= n;
+  }
+  pane->last_character = pane->character;
+  pane->last_character.data.utf8 = (struct tym_i_utf8_character_state){
+    .data = { span[-1] },
+    .count = 1
+  };
+  tym_i_pane_update_cursor(pane);
+}
+
 /** Write the sequences and parameters to the debug output */
 void tym_i_debug_sequence_params(const struct tym_i_command_sequence* command, const struct tym_i_sequence_state* state){
   tym_u_rawlog(TYM_LOG_DEBUG, "%s", command->callback_name);
@@ -358,142 +831,259 @@ void tym_i_debug_sequence_params(const struct tym_i_command_sequence* command, c
   }
 }
 
-/**
- * This is the parser/interpreter. The sequences are sorted, so this parser just checks
- * if a character is larger or smaller than the corresponding one of the first/past possible
- * sequence, and adjusts those boundaries until only one is left and matches.
- * If no sequence matches, the first character is sent directly and the remaining ones
- * are parsed using this function again.
- */
-void tym_i_pane_parse(struct tym_i_pane_internal* pane, unsigned char c){
-//  TYM_U_LOG(TYM_LOG_DEBUG, "tym_i_pane_parse %.2X\n", c);
-  if(tym_i_character_is_utf8(pane->character))
-    if( pane->character.data.utf8.count )
-      if(print_character_update(pane, c))
-        return;
-  unsigned short n = pane->sequence.length;
-  unsigned short index = pane->sequence.index;
-  if(n >= TYM_I_MAX_SEQ_LEN)
-    goto escape_abort;
-  if(!pane->sequence.length){
-    pane->sequence.seq_opt_min = 0;
-    pane->sequence.seq_opt_max = tym_i_command_sequence_map_count-1;
-    
-    // Optional optimisation: The fist character is currently always \x1B, checking every single
-    // entry in that case would be unnecessary and really inefficent. Let's check that right away
-    // in a way that won't break if that changes some day.
-    if( command_sequence_comparator_ch(tym_i_command_sequence_map[0].sequence[index], c) > 0
-     || command_sequence_comparator_ch(tym_i_command_sequence_map[tym_i_command_sequence_map_count-1].sequence[index], c) < 0
-    ) pane->sequence.seq_opt_max = -1;
-    // end optimisation
-  }
-  ssize_t min = pane->sequence.seq_opt_min;
-  ssize_t max = pane->sequence.seq_opt_max;
-  if( pane->sequence.last_special_match_continue && !specialmatch(tym_i_command_sequence_map[min].sequence[index], c) )
-    index++;
-  while( max >= min && ( tym_i_command_sequence_map[min].length <= index || (
-         tym_i_command_sequence_map[min].length > index
-      && command_sequence_comparator_ch(tym_i_command_sequence_map[min].sequence[index], c) < 0
-      && !specialmatch(tym_i_command_sequence_map[min].sequence[index], c)
-  ))) min++;
-  if( max >=min && tym_i_command_sequence_map[min].sequence[index] >= ' ' && command_sequence_comparator_ch(tym_i_command_sequence_map[min].sequence[index], c) > 0)
-  while( max >= min && (
-        tym_i_command_sequence_map[min].length <= index // Order sensitive!!
-     || tym_i_command_sequence_map[min].sequence[index] >= ' '
-     || !specialmatch(tym_i_command_sequence_map[min].sequence[index], c)
-  )) min++;
-  bool esm = false;
-  if(max >= min && tym_i_command_sequence_map[min].length > index)
-    if(specialmatch(tym_i_command_sequence_map[min].sequence[index], c))
-      esm = true;
-  while( max >= min && tym_i_command_sequence_map[max].length > index
-      && command_sequence_comparator_ch(tym_i_command_sequence_map[max].sequence[index], c) > 0
-      && (!esm||!specialmatch(tym_i_command_sequence_map[min].sequence[index], c))
-  ) max--;
-/*  if(max < min)
-    fprintf(stderr,"%*s %c\n",(int)pane->sequence.length,pane->sequence.buffer, c);*/
-  if(max < min || index >= tym_i_command_sequence_map[min].length || index >= tym_i_command_sequence_map[max].length){
-    if(control_character(pane, c)){
-      if(tym_i_nocsq_test_hook)
-        tym_i_nocsq_test_hook(pane, c);
-      return;
-    }else{
-      goto escape_abort;
-    }
-  }
-  pane->sequence.seq_opt_min = min;
-  pane->sequence.seq_opt_max = max;
-  if(max >= min && tym_i_command_sequence_map[min].sequence[index] < ' '){
-    switch(tym_i_command_sequence_map[min].sequence[index]){
-      case '\1': {
-        if(++pane->sequence.integer_count >= TYM_I_MAX_INT_COUNT)
-          goto escape_abort;
-        pane->sequence.integer[pane->sequence.integer_count-1] = c;
-      } break;
-      case '\2': {
-        if(!pane->sequence.integer_count)
-          pane->sequence.integer_count = 1;
-        if(c == ';'){
-          if(++pane->sequence.integer_count >= TYM_I_MAX_INT_COUNT)
-            goto escape_abort;
-        }else if(c >= '0' && c <= '9'){
-          pane->sequence.integer[pane->sequence.integer_count-1] *= 10;
-          pane->sequence.integer[pane->sequence.integer_count-1] += c - '0';
-        }else goto escape_abort;
-      } break;
-    }
+/** Call the callback of a complete escape sequence. */
+static void dispatch(struct tym_i_pane_internal* pane, const struct tym_i_command_sequence* command, unsigned char c){
+  if(!command){
+    TYM_U_LOG(TYM_LOG_DEBUG, "Unknown escape sequence ending with %.2X\n", (int)c);
+    goto unknown;
   }
-  if(min == max && index+1 == tym_i_command_sequence_map[min].length){
-    const struct tym_i_command_sequence* command = tym_i_command_sequence_map + min;
-    if(command->callback){
-      int ret = command->callback(pane);
-      if(tym_i_csq_test_hook)
-        tym_i_csq_test_hook(pane, ret, command);
-      if(ret == -1){
-        int err = errno;
+  size_t index = command - tym_i_command_sequence_map;
+  if(command->callback){
+    uint64_t start = tym_i_trace_begin();
+    uint64_t profile_start = tym_i_profile_begin();
+    int ret = command->callback(pane);
+    tym_i_profile_end(index, profile_start);
+    tym_i_trace_end(pane, TYM_I_TRACE_SEQUENCE, start);
+    if(tym_i_csq_test_hook)
+      tym_i_csq_test_hook(pane, ret, command);
+    if(ret == -1){
+      int err = errno;
+      if(TYM_U_LOG_ENABLED(TYM_LOG_DEBUG)){
         TYM_U_LOG(TYM_LOG_DEBUG, "- ");
         tym_i_debug_sequence_params(command, &pane->sequence);
         tym_u_rawlog(TYM_LOG_DEBUG, ": %d %s\n", err, strerror(err));
-        if(err == ENOENT)
-          goto escape_abort;
-      }else{
-        tym_i_pane_update_cursor(pane);
+      }
+      if(err == ENOENT)
+        goto unknown;
+    }else{
+      tym_i_pane_update_cursor(pane);
+      if(TYM_U_LOG_ENABLED(TYM_LOG_DEBUG)){
         TYM_U_LOG(TYM_LOG_DEBUG, "+ ");
         tym_i_debug_sequence_params(command, &pane->sequence);
         tym_u_rawlog(TYM_LOG_DEBUG, "\n");
       }
-    }else{
-      TYM_U_LOG(TYM_LOG_DEBUG, "? ");
-      tym_i_debug_sequence_params(command, &pane->sequence);
-      tym_u_rawlog(TYM_LOG_DEBUG, "\n");
     }
-    reset_sequence(&pane->sequence);
+  }else if(TYM_U_LOG_ENABLED(TYM_LOG_DEBUG)){
+    TYM_U_LOG(TYM_LOG_DEBUG, "? ");
+    tym_i_debug_sequence_params(command, &pane->sequence);
+    tym_u_rawlog(TYM_LOG_DEBUG, "\n");
+  }
+  pane->stats.sequence[index]++;
+  return;
+unknown:
+  pane->stats.sequences_unknown++;
+  // Unknown escape sequences are discarded as a whole, see ECMA-48 5.4
+  if(tym_i_nocsq_test_hook)
+    tym_i_nocsq_test_hook(pane, c);
+}
+
+/** Look up the callback for an escape sequence and call it. */
+static void dispatch_sequence(struct tym_i_pane_internal* pane, enum sequence_kind kind, unsigned char c){
+  struct tym_i_sequence_state* sequence = &pane->sequence;
+  short i = lookup_sequence(kind, sequence, c);
+  if(i == -1){
+    dispatch(pane, 0, c);
+    return;
+  }
+  const struct tym_i_command_sequence* command = &tym_i_command_sequence_map[i];
+  if(kind == SK_ESC && !command_sequence_key[i].final){
+    sequence->integer[0] = c;
+    sequence->integer_count = 1;
+  }
+  if(command_sequence_key[i].trailing_character){
+    sequence->command = command;
+    sequence->state = TYM_I_PS_ESCAPE_CHARACTER;
+    return;
+  }
+  dispatch(pane, command, c);
+}
+
+/** Add a digit or separator to the integer arguments of a control sequence. */
+static void add_parameter(struct tym_i_sequence_state* sequence, unsigned char c){
+  if(!sequence->integer_count)
+    sequence->integer_count = 1;
+  if(c == ';'){
+    if(sequence->integer_count >= TYM_I_MAX_INT_COUNT){
+      sequence->state = TYM_I_PS_CSI_IGNORE;
+      return;
+    }
+    sequence->integer_count++;
     return;
   }
-  pane->sequence.buffer[n] = c;
-  pane->sequence.length = n + 1;
-  if( specialmatch(tym_i_command_sequence_map[min].sequence[index], c) == SM_MATCH_CONTINUE ){
-    pane->sequence.last_special_match_continue = true;
+  int* x = &sequence->integer[sequence->integer_count-1];
+  if(*x > (INT_MAX - 9) / 10){
+    *x = INT_MAX;
   }else{
-    pane->sequence.index = index + 1;
+    *x = *x * 10 + (c - '0');
   }
-  return;
-escape_abort:;
-  char fc = pane->sequence.length ? pane->sequence.buffer[0] : c;
-  if(tym_i_nocsq_test_hook)
-    tym_i_nocsq_test_hook(pane, fc);
-  switch(fc){
-    case '\x1B': print_character_update(pane, '^'); break;
-    default: print_character_update(pane, fc); break;
+}
+
+/** Pass an event of the current control string to the handler of its escape sequence, see tym_i_csq_string_callback */
+static void string_event(struct tym_i_pane_internal* pane, enum tym_i_string_event event){
+  const struct tym_i_command_sequence* command = pane->sequence.command;
+  if(command && command->string_callback)
+    command->string_callback(pane, event, 0, "");
+}
+
+/** Start a control string, c is the character following ESC. */
+static void string_start(struct tym_i_pane_internal* pane, unsigned char c){
+  struct tym_i_sequence_state* sequence = &pane->sequence;
+  short i = lookup_sequence(c == ']' ? SK_OSC : SK_STRING, sequence, c);
+  sequence->command = i == -1 ? 0 : &tym_i_command_sequence_map[i];
+  if(c == ']'){
+    // The command number is parsed first, see string_put
+    sequence->integer_count = 1;
+    return;
   }
-  if(pane->sequence.length){
-    TYM_U_LOG(TYM_LOG_DEBUG, "%.*s%c %zd %zd\n",(int)pane->sequence.length,pane->sequence.buffer,c, pane->sequence.seq_opt_min, pane->sequence.seq_opt_max);
-    reset_sequence(&pane->sequence);
-    for(unsigned short i=1; i<n; i++)
-      tym_i_pane_parse(pane, pane->sequence.buffer[i]);
-    tym_i_pane_parse(pane, c);
+  sequence->string_started = true;
+  string_event(pane, TYM_I_STRING_START);
+}
+
+/**
+ * Pass a part of the current control string to the handler of its escape sequence, in parts of at most
+ * tym_i_string_chunk_size bytes. The command number at the start of an operating system command is
+ * parsed first. It ends at the first character which isn't a digit, which is skipped if it's a ';'.
+ */
+static void string_put(struct tym_i_pane_internal* pane, size_t size, const unsigned char data[size]){
+  struct tym_i_sequence_state* sequence = &pane->sequence;
+  if(!sequence->string_started){
+    int* x = &sequence->integer[0];
+    for(; size && *data >= '0' && *data <= '9'; size--, data++)
+      *x = *x > (INT_MAX - 9) / 10 ? INT_MAX : *x * 10 + (*data - '0');
+    if(!size)
+      return;
+    if(*data == ';'){
+      data++;
+      size--;
+    }
+    sequence->string_started = true;
+    string_event(pane, TYM_I_STRING_START);
+  }
+  const struct tym_i_command_sequence* command = sequence->command;
+  if(!command || !command->string_callback)
+    return;
+  while(size){
+    size_t n = size < tym_i_string_chunk_size ? size : tym_i_string_chunk_size;
+    command->string_callback(pane, TYM_I_STRING_DATA, n, (const char*)data);
+    data += n;
+    size -= n;
+  }
+}
+
+/** The end of a control string, call the callback of its escape sequence. */
+static void string_dispatch(struct tym_i_pane_internal* pane, unsigned char c){
+  struct tym_i_sequence_state* sequence = &pane->sequence;
+  if(!sequence->string_started){
+    sequence->string_started = true;
+    string_event(pane, TYM_I_STRING_START);
+  }
+  dispatch(pane, sequence->command, c);
+  reset_sequence(sequence);
+}
+
+/**
+ * This is the parser/interpreter. It's a state machine as described in ECMA-48,
+ * every character is classified using character_class, and the action to take
+ * and the next state are taken from transition_table. Complete escape sequences
+ * are looked up by their final character, see lookup_sequence.
+ */
+void tym_i_pane_parse(struct tym_i_pane_internal* pane, unsigned char c){
+  if(tym_i_character_is_utf8(pane->character))
+    if( pane->character.data.utf8.count )
+      if(print_character_update(pane, c))
+        return;
+  struct tym_i_sequence_state* sequence = &pane->sequence;
+  const struct parser_transition transition = transition_table[sequence->state][character_class[c]];
+  if(transition.state != PS_STAY){
+    sequence->state = transition.state;
+    switch(transition.state){
+      case TYM_I_PS_ESCAPE:
+      case TYM_I_PS_CSI_ENTRY:
+      case TYM_I_PS_OSC_STRING:
+      case TYM_I_PS_STRING: {
+        if(transition.action != PA_STRING_DISPATCH)
+          reset_sequence(sequence);
+      } break;
+    }
+  }
+  switch((enum parser_action)transition.action){
+    case PA_NONE: break;
+    case PA_PRINT: print_span(pane, 1, &c); break;
+    case PA_EXECUTE: {
+      control_character(pane, c);
+      if(tym_i_nocsq_test_hook)
+        tym_i_nocsq_test_hook(pane, c);
+    } break;
+    case PA_COLLECT: {
+      if(c >= 0x3C && c <= 0x3F){
+        sequence->private_marker = c;
+      }else if(sequence->intermediate_count < TYM_I_MAX_INTERMEDIATE_COUNT){
+        sequence->intermediate[sequence->intermediate_count++] = c;
+      }else{
+        // No escape sequence template has that many, make sure none of them match
+        sequence->intermediate_count = TYM_I_MAX_INTERMEDIATE_COUNT + 1;
+      }
+    } break;
+    case PA_PARAMETER: add_parameter(sequence, c); break;
+    case PA_ESC_DISPATCH: dispatch_sequence(pane, SK_ESC, c); break;
+    case PA_CSI_DISPATCH: dispatch_sequence(pane, SK_CSI, c); break;
+    case PA_CHARACTER: {
+      sequence->integer[0] = c;
+      sequence->integer_count = 1;
+      dispatch(pane, sequence->command, c);
+    } break;
+    case PA_STRING_START: string_start(pane, c); break;
+    case PA_STRING_PUT: string_put(pane, 1, &c); break;
+    case PA_STRING_DISPATCH: string_dispatch(pane, c); break;
+    case PA_STRING_ABORT: {
+      string_event(pane, TYM_I_STRING_ABORT);
+      reset_sequence(sequence);
+    } break;
+    case PA_UNKNOWN: dispatch(pane, 0, c); break;
   }
-  tym_i_pane_update_cursor(pane);
-  return;
 }
 
+/**
+ * Parse a whole buffer read from the pseudo terminal master.
+ * Runs of printable characters are handed to the print path directly,
+ * runs of printable ascii characters are found using tym_i_scan_printable_ascii.
+ * The content of control strings is passed to their handler in runs as well.
+ * Only escape sequences and control characters go through tym_i_pane_parse.
+ */
+void tym_i_pane_parse_buffer(struct tym_i_pane_internal* pane, const char* buffer, size_t length){
+  const unsigned char* it = (const unsigned char*)buffer;
+  const unsigned char* end = it + length;
+  while(it < end){
+    if(pane->sequence.state == TYM_I_PS_GROUND){
+      const unsigned char* start = it;
+      if(tym_i_character_is_utf8(pane->character) && !pane->character.data.utf8.count){
+        size_t n = tym_i_scan_printable_ascii(end - it, it);
+        if(n){
+          print_ascii_span(pane, n, it);
+          it += n;
+          continue;
+        }
+        while(it < end && *it >= 0x80)
+          it++;
+      }else{
+        while(it < end && is_printable(*it))
+          it++;
+      }
+      if(it != start){
+        print_span(pane, it - start, start);
+        continue;
+      }
+    }else if(pane->sequence.string_started){
+      // Pass the content of control strings on as is, without looking at it one character at a time
+      const struct parser_transition* transition = transition_table[pane->sequence.state];
+      const unsigned char* start = it;
+      while(it < end && transition[character_class[*it]].action == PA_STRING_PUT)
+        it++;
+      if(it != start){
+        string_put(pane, it - start, start);
+        continue;
+      }
+    }
+    tym_i_pane_parse(pane, *it++);
+  }
+}
@@ -0,0 +1,201 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <internal/log.h>
+#include <internal/parser.h>
+#include <internal/profile.h>
+#include <libttymultiplex.h>
+
+/** \file */
+
+/** The calls of the handler of an escape sequence, all fields are accessed atomically */
+struct tym_i_profile_entry {
+  /** The number of calls */
+  uint64_t count;
+  /** The total duration of the calls in nanoseconds */
+  uint64_t total;
+  /** The duration of the longest call in nanoseconds */
+  uint64_t max;
+  /** The number of calls in every bucket, see bucket_index */
+  uint64_t bucket[TYM_I_PROFILE_BUCKET_COUNT];
+};
+
+bool tym_i_profile_enabled;
+
+/** Protects the allocation of entry_list */
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * One entry for every entry of the escape sequence table. It's allocated when profiling is
+ * enabled for the first time and never freed, so it can be used without holding any lock.
+ */
+static struct tym_i_profile_entry* entry_list;
+
+/** The bucket a duration belongs to */
+static unsigned bucket_index(uint64_t duration){
+  if(duration < TYM_I_PROFILE_SUB_BUCKET_COUNT)
+    return duration;
+  if(duration > UINT32_MAX)
+    duration = UINT32_MAX;
+  unsigned msb = 63 - __builtin_clzll(duration);
+  unsigned sub = (duration >> (msb - TYM_I_PROFILE_SUB_BUCKET_BITS)) - TYM_I_PROFILE_SUB_BUCKET_COUNT;
+  return (msb - TYM_I_PROFILE_SUB_BUCKET_BITS + 1) * TYM_I_PROFILE_SUB_BUCKET_COUNT + sub;
+}
+
+/** The smallest duration which belongs to a bucket */
+static uint64_t bucket_start(unsigned index){
+  if(index < TYM_I_PROFILE_SUB_BUCKET_COUNT)
+    return index;
+  unsigned msb = index / TYM_I_PROFILE_SUB_BUCKET_COUNT + TYM_I_PROFILE_SUB_BUCKET_BITS - 1;
+  unsigned sub = index % TYM_I_PROFILE_SUB_BUCKET_COUNT;
+  return (uint64_t)(TYM_I_PROFILE_SUB_BUCKET_COUNT + sub) << (msb - TYM_I_PROFILE_SUB_BUCKET_BITS);
+}
+
+/**
+ * Add a call of the handler of entry index of the escape sequence table, started
+ * at the time returned by tym_i_profile_begin. The handlers of different panes may be
+ * called at the same time, so no locks are used, only atomic operations.
+ */
+void tym_i_profile_end(size_t index, uint64_t start){
+  if(!start)
+    return;
+  uint64_t duration = tym_i_trace_now() - start;
+  struct tym_i_profile_entry* entry = __atomic_load_n(&entry_list, __ATOMIC_ACQUIRE);
+  if(!entry || index >= tym_i_command_sequence_map_count)
+    return;
+  entry += index;
+  __atomic_fetch_add(&entry->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&entry->total, duration, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&entry->bucket[bucket_index(duration)], 1, __ATOMIC_RELAXED);
+  uint64_t max = __atomic_load_n(&entry->max, __ATOMIC_RELAXED);
+  while(max < duration && !__atomic_compare_exchange_n(&entry->max, &max, duration, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+int tym_set_profiling(bool enable){
+  if(enable && !__atomic_load_n(&entry_list, __ATOMIC_ACQUIRE)){
+    pthread_mutex_lock(&profile_lock);
+    if(!entry_list){
+      struct tym_i_profile_entry* list = calloc(tym_i_command_sequence_map_count, sizeof(*list));
+      if(!list){
+        pthread_mutex_unlock(&profile_lock);
+        return -1;
+      }
+      __atomic_store_n(&entry_list, list, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&profile_lock);
+  }
+  __atomic_store_n(&tym_i_profile_enabled, enable, __ATOMIC_RELAXED);
+  return 0;
+}
+
+/**
+ * A line of the output of tym_profile_dump. snprintf & stdio aren't async-signal-safe,
+ * the lines are put together using these functions instead.
+ */
+struct dump_line {
+  size_t size;
+  char data[4096];
+};
+
+static void line_string(struct dump_line* line, const char* s){
+  while(*s && line->size < sizeof(line->data))
+    line->data[line->size++] = *s++;
+}
+
+static void line_number(struct dump_line* line, uint64_t x){
+  char digits[20];
+  size_t n = 0;
+  do {
+    digits[n++] = '0' + x % 10;
+    x /= 10;
+  } while(x);
+  while(n && line->size < sizeof(line->data))
+    line->data[line->size++] = digits[--n];
+}
+
+static int line_write(int fd, struct dump_line* line){
+  size_t offset = 0;
+  while(offset < line->size){
+    ssize_t ret = write(fd, line->data + offset, line->size - offset);
+    if(ret == -1 && errno == EINTR)
+      continue;
+    if(ret <= 0)
+      return -1;
+    offset += ret;
+  }
+  line->size = 0;
+  return 0;
+}
+
+/** The start of the bucket in which the call at the specified fraction of all calls ended up */
+static uint64_t percentile(const uint64_t bucket[TYM_I_PROFILE_BUCKET_COUNT], uint64_t count, unsigned permille){
+  uint64_t rank = (count * permille + 999) / 1000;
+  uint64_t sum = 0;
+  for(unsigned i=0; i<TYM_I_PROFILE_BUCKET_COUNT; i++){
+    sum += bucket[i];
+    if(sum >= rank && sum)
+      return bucket_start(i);
+  }
+  return bucket_start(TYM_I_PROFILE_BUCKET_COUNT-1);
+}
+
+/**
+ * Write the profile of every escape sequence handler which was called. This is async-signal-safe:
+ * it takes no locks and allocates no memory, the counters are only read atomically.
+ */
+int tym_profile_dump(int fd){
+  if(fd == -1)
+    fd = tym_i_log_fd();
+  if(fd == -1){
+    errno = EBADF;
+    return -1;
+  }
+  const struct tym_i_profile_entry* list = __atomic_load_n(&entry_list, __ATOMIC_ACQUIRE);
+  struct dump_line line = {0};
+  line_string(&line, "escape sequence handler profile, durations in ns: count total mean p50 p90 p99 max\n");
+  if(line_write(fd, &line) == -1)
+    return -1;
+  for(size_t i=0; list && i<tym_i_command_sequence_map_count; i++){
+    const struct tym_i_profile_entry* entry = &list[i];
+    uint64_t count = __atomic_load_n(&entry->count, __ATOMIC_RELAXED);
+    if(!count)
+      continue;
+    uint64_t bucket[TYM_I_PROFILE_BUCKET_COUNT];
+    uint64_t bucket_count = 0;
+    for(unsigned j=0; j<TYM_I_PROFILE_BUCKET_COUNT; j++)
+      bucket_count += bucket[j] = __atomic_load_n(&entry->bucket[j], __ATOMIC_RELAXED);
+    uint64_t total = __atomic_load_n(&entry->total, __ATOMIC_RELAXED);
+    const char* name = tym_sequence_name(i);
+    line_string(&line, name && *name ? name : "(unnamed)");
+    line_string(&line, ": ");
+    line_number(&line, count);
+    line_string(&line, " ");
+    line_number(&line, total);
+    line_string(&line, " ");
+    line_number(&line, total / count);
+    static const unsigned permille[] = {500, 900, 990};
+    for(size_t j=0; j<sizeof(permille)/sizeof(*permille); j++){
+      line_string(&line, " ");
+      line_number(&line, percentile(bucket, bucket_count, permille[j]));
+    }
+    line_string(&line, " ");
+    line_number(&line, __atomic_load_n(&entry->max, __ATOMIC_RELAXED));
+    line_string(&line, "\n ");
+    for(unsigned j=0; j<TYM_I_PROFILE_BUCKET_COUNT; j++){
+      if(!bucket[j])
+        continue;
+      line_string(&line, " ");
+      line_number(&line, bucket_start(j));
+      line_string(&line, ":");
+      line_number(&line, bucket[j]);
+    }
+    line_string(&line, "\n");
+    if(line_write(fd, &line) == -1)
+      return -1;
+  }
+  return 0;
+}
@@ -4,6 +4,8 @@
 #include <errno.h>
 #include <unistd.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <internal/main.h>
 #include <internal/parser.h>
 #include <internal/pseudoterminal.h>
@@ -11,65 +13,225 @@
 
 /** \file */
 
-#define S(X) sizeof(X)-1, X
+/** Append data to the send queue of a pane, making room for it if necessary. */
+static int send_queue_append(struct tym_i_send_queue* queue, size_t size, const char* data){
+  if(queue->offset && queue->offset + queue->size + size > queue->capacity){
+    memmove(queue->data, queue->data + queue->offset, queue->size);
+    queue->offset = 0;
+  }
+  if(queue->size + size > queue->capacity){
+    size_t capacity = queue->capacity ? queue->capacity : 256;
+    while(capacity < queue->size + size)
+      capacity *= 2;
+    char* buffer = realloc(queue->data, capacity);
+    if(!buffer)
+      return -1;
+    queue->data = buffer;
+    queue->capacity = capacity;
+  }
+  memcpy(queue->data + queue->offset + queue->size, data, size);
+  queue->size += size;
+  return 0;
+}
+
+/**
+ * Write some data to the pseudo terminal master, see tym_i_pts_send. If bounded isn't set, the data
+ * is queued even if the queue is full, this is for data which mustn't be lost, like the end of a paste.
+ */
+static int send_data(struct tym_i_pane_internal* pane, size_t size, const void*restrict data, bool bounded){
+  if(!pane){
+    errno = EINVAL;
+    return -1;
+  }
+  struct tym_i_send_queue* queue = &pane->send_queue;
+  // Don't let the data overtake what's queued already
+  bool queued = queue->size;
+  while(size && !queued){
+    ssize_t ret = write(pane->master, data, size);
+    if(ret == -1){
+      if(errno == EINTR)
+        continue;
+      if(errno != EAGAIN)
+        return -1;
+      break;
+    }
+    data = (const char*)data + ret;
+    size -= ret;
+  }
+  if(!size)
+    return 0;
+  if(bounded && queue->size + size > tym_i_send_queue_limit){
+    if(tym_i_send_overflow == TYM_SEND_OVERFLOW_DISCARD)
+      return 0;
+    errno = EAGAIN;
+    return -1;
+  }
+  if(send_queue_append(queue, size, data) == -1)
+    return -1;
+  if(queued)
+    return 0;
+  // The queue was empty, so the main loop isn't watching the master for POLLOUT yet
+  if(tym_i_request_send_queue_flush(pane->id) == -1)
+    TYM_U_PERROR(TYM_LOG_ERROR, "tym_i_request_send_queue_flush failed");
+  return 0;
+}
 
 /**
  * Write some data to the pseudo terminal master (ptm), so it can be read by the pseudo terminal slave (pts).
  * The pseudo terminal (pty) may modifythe these data though, see termios(3). Use one of the other
  * tym_i_pts_* functions to deal with that.
+ *
+ * This never waits for the program in the pane to read its input. What can't be written right away
+ * is queued, and the main loop writes it once the master is writable again, see tym_i_pts_flush.
+ * At most tym_i_send_queue_limit bytes are queued. If the part which couldn't be written right away
+ * doesn't fit into the queue anymore, that part is handled as tym_i_send_overflow says.
+ * The lock of the pane has to be held.
  */
 int tym_i_pts_send(struct tym_i_pane_internal* pane, size_t size, const void*restrict data){
-  if(!pane){
-    errno = EINVAL;
-    return -1;
+  return send_data(pane, size, data, true);
+}
+
+enum {
+  /** The maximum number of bytes of pasted text passed to tym_i_pts_send at once, see paste_fill */
+  TYM_I_PASTE_CHUNK_SIZE = 4096
+};
+
+/**
+ * Finish pasting, also if the text couldn't be passed on completely. In bracketed paste mode, the end
+ * marker is sent even if the queue is full, the program would treat everything after the start marker
+ * as pasted otherwise.
+ */
+static int paste_end(struct tym_i_pane_internal* pane){
+  static const char end[] = CSI "201~";
+  int ret = 0;
+  if(pane->paste.bracketed)
+    ret = send_data(pane, sizeof(end) - 1, end, false);
+  free(pane->paste.buffer);
+  pane->paste = (struct tym_i_paste){0};
+  return ret;
+}
+
+/**
+ * Pass on the text which is being pasted into a pane in chunks, for as long as they fit into the queue.
+ * A chunk is never larger than the queue. Line breaks are translated & end markers are removed one chunk
+ * at a time. The end marker of bracketed paste mode is only sent once all of the text was passed on,
+ * or if passing it on failed, see paste_end. The lock of the pane has to be held.
+ */
+static int paste_fill(struct tym_i_pane_internal* pane){
+  static const char end[] = CSI "201~";
+  const size_t marker = sizeof(end) - 1;
+  struct tym_i_paste* paste = &pane->paste;
+  const struct tym_i_send_queue* queue = &pane->send_queue;
+  size_t chunk = TYM_I_PASTE_CHUNK_SIZE;
+  if(tym_i_send_queue_limit && tym_i_send_queue_limit < chunk)
+    chunk = tym_i_send_queue_limit;
+  while(paste->size){
+    // Don't queue more than fits, but always send something if nothing is queued
+    if(queue->size && queue->size + chunk > tym_i_send_queue_limit)
+      return 0;
+    char buffer[TYM_I_PASTE_CHUNK_SIZE];
+    size_t count = 0;
+    const char* it = paste->text + paste->offset;
+    const char* text_end = it + paste->size;
+    while(count < chunk && it < text_end){
+      char c = *it++;
+      bool cr = paste->cr;
+      paste->cr = c == '\r';
+      if(c == '\n'){
+        if(cr)
+          continue;
+        c = '\r';
+      }else if(paste->bracketed && c == '\033' && (size_t)(text_end - it) >= marker - 1 && !memcmp(it, end + 1, marker - 1)){
+        it += marker - 1;
+        continue;
+      }
+      buffer[count++] = c;
+    }
+    size_t consumed = it - (paste->text + paste->offset);
+    paste->offset += consumed;
+    paste->size -= consumed;
+    if(count && tym_i_pts_send(pane, count, buffer) == -1){
+      int error = errno;
+      paste_end(pane);
+      errno = error;
+      return -1;
+    }
   }
-  ssize_t ret = 0;
-  while((ret=write(pane->master, data, size)) == -1 && (errno == EAGAIN || errno == EINTR));
-  return ret == -1 ? -1 : 0;
+  return paste_end(pane);
 }
 
 /**
- * \see tym_pane_send_key
+ * Write as much of the queued data of a pane as possible without waiting, and queue more of the text
+ * being pasted if there is room for it now. The lock of the pane has to be held.
+ * Returns 0 if nothing is queued anymore, 1 if some of it couldn't be written yet, and -1 on error.
  */
-int tym_i_pts_send_key(struct tym_i_pane_internal* pane, uint_least16_t key){
-  if(!pane){
-    errno = EINVAL;
-    return -1;
+int tym_i_pts_flush(struct tym_i_pane_internal* pane){
+  struct tym_i_send_queue* queue = &pane->send_queue;
+  while(queue->size){
+    ssize_t ret = write(pane->master, queue->data + queue->offset, queue->size);
+    if(ret == -1){
+      if(errno == EINTR)
+        continue;
+      if(errno != EAGAIN)
+        return -1;
+      break;
+    }
+    queue->offset += ret;
+    queue->size -= ret;
   }
+  if(!queue->size)
+    queue->offset = 0;
+  if(pane->paste.text && paste_fill(pane) == -1){
+    // The rest of the text didn't fit into the queue, that's no reason to drop what's queued
+    if(errno != EAGAIN)
+      return -1;
+    TYM_U_LOG(TYM_LOG_WARN, "The pasted text doesn't fit into the send queue, the rest of it was dropped\n");
+  }
+  return queue->size ? 1 : 0;
+}
+
+/** Drop the queued data & the text still to be pasted of a pane & free them. The lock of the pane has to be held. */
+void tym_i_pts_discard(struct tym_i_pane_internal* pane){
+  free(pane->send_queue.data);
+  pane->send_queue = (struct tym_i_send_queue){0};
+  free(pane->paste.buffer);
+  pane->paste = (struct tym_i_paste){0};
+}
+
+enum {
+  /** The maximum length of the sequence sent for a key, see key_encode */
+  TYM_I_KEY_SEQUENCE_MAX = 4
+};
+
+/**
+ * Get the bytes to send for a key, see tym_pane_send_key.
+ * Returns the number of bytes stored in sequence, or -1 if the key can't be sent.
+ */
+static int key_encode(const struct tym_i_pane_internal* pane, uint_least16_t key, char sequence[TYM_I_KEY_SEQUENCE_MAX]){
   if( key & TYM_KEY_MODIFIER_CTRL && ( (key & ~TYM_KEY_MODIFIER_CTRL) < 0x40 || (key & ~TYM_KEY_MODIFIER_CTRL) >= 0x80 ) )
     key &= ~TYM_KEY_MODIFIER_CTRL; // Ignore control key for these keys
-  struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
-  #define CS(X) case TYM_KEY_ ## X:
+  const struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
+  bool application = screen->cursor_key_mode == TYM_I_CURSOR_KEY_MODE_APPLICATION;
+  const char* special = 0;
   switch((enum tym_special_key)key){
-    CS(UP) CS(DOWN) CS(RIGHT) CS(LEFT) CS(HOME) CS(END) {
-      switch(screen->cursor_key_mode){
-        case TYM_I_KEYPAD_MODE_NORMAL: switch(key){
-            case TYM_KEY_UP   : return tym_i_pts_send(pane, S(CSI "A"));
-            case TYM_KEY_DOWN : return tym_i_pts_send(pane, S(CSI "B"));
-            case TYM_KEY_RIGHT: return tym_i_pts_send(pane, S(CSI "C"));
-            case TYM_KEY_LEFT : return tym_i_pts_send(pane, S(CSI "D"));
-            case TYM_KEY_HOME : return tym_i_pts_send(pane, S(CSI "H"));
-            case TYM_KEY_END  : return tym_i_pts_send(pane, S(CSI "F"));
-            default: return -1;
-        } break;
-        case TYM_I_KEYPAD_MODE_APPLICATION: switch(key){
-            case TYM_KEY_UP   : return tym_i_pts_send(pane, S(SS3 "A"));
-            case TYM_KEY_DOWN : return tym_i_pts_send(pane, S(SS3 "B"));
-            case TYM_KEY_RIGHT: return tym_i_pts_send(pane, S(SS3 "C"));
-            case TYM_KEY_LEFT : return tym_i_pts_send(pane, S(SS3 "D"));
-            case TYM_KEY_HOME : return tym_i_pts_send(pane, S(SS3 "H"));
-            case TYM_KEY_END  : return tym_i_pts_send(pane, S(SS3 "F"));
-            default: return -1;
-        } break;
-      }
-    } break;
-    case TYM_KEY_PAGE_UP: return tym_i_pts_send(pane, S(CSI "5~"));
-    case TYM_KEY_PAGE_DOWN: return tym_i_pts_send(pane, S(CSI "6~"));
-    case TYM_KEY_ENTER: return tym_i_pts_send(pane, S("\r"));
-    case TYM_KEY_TAB: break;
+    case TYM_KEY_UP       : special = application ? SS3 "A" : CSI "A"; break;
+    case TYM_KEY_DOWN     : special = application ? SS3 "B" : CSI "B"; break;
+    case TYM_KEY_RIGHT    : special = application ? SS3 "C" : CSI "C"; break;
+    case TYM_KEY_LEFT     : special = application ? SS3 "D" : CSI "D"; break;
+    case TYM_KEY_HOME     : special = application ? SS3 "H" : CSI "H"; break;
+    case TYM_KEY_END      : special = application ? SS3 "F" : CSI "F"; break;
+    case TYM_KEY_PAGE_UP  : special = CSI "5~"; break;
+    case TYM_KEY_PAGE_DOWN: special = CSI "6~"; break;
+    case TYM_KEY_ENTER    : special = "\r"; break;
+    case TYM_KEY_TAB      : break;
     case TYM_KEY_BACKSPACE: break;
-    case TYM_KEY_ESCAPE: break;
-    case TYM_KEY_DELETE: return tym_i_pts_send(pane, S(CSI "3~"));
+    case TYM_KEY_ESCAPE   : break;
+    case TYM_KEY_DELETE   : special = CSI "3~"; break;
+  }
+  if(special){
+    size_t length = strlen(special);
+    memcpy(sequence, special, length);
+    return length;
   }
   if( key & TYM_KEY_MODIFIER_CTRL ){
     key &= ~TYM_KEY_MODIFIER_CTRL;
@@ -79,27 +241,133 @@ int tym_i_pts_send_key(struct tym_i_pane_internal* pane, uint_least16_t key){
       key = (key & ~TYM_KEY_MODIFIER_CTRL) - 0x60;
     }
   }
-  if(key < 0x100)
-    return tym_i_pts_send(pane, 1, (char[]){key});
-#undef CS
-  return -1;
+  if(key >= 0x100)
+    return -1;
+  sequence[0] = key;
+  return 1;
+}
+
+/**
+ * Encode all keys into one buffer, and send it at once, instead of sending them one by one.
+ * Keys which can't be sent are skipped, like tym_i_pts_send_key would.
+ */
+static int send_key_list(struct tym_i_pane_internal* pane, size_t count, const void* keys, uint_least16_t(*get)(const void* keys, size_t i)){
+  char sequence[TYM_I_KEY_SEQUENCE_MAX];
+  size_t size = 0;
+  for(size_t i=0; i<count; i++){
+    int length = key_encode(pane, get(keys, i), sequence);
+    if(length > 0)
+      size += length;
+  }
+  if(!size)
+    return 0;
+  char* buffer = malloc(size);
+  if(!buffer)
+    return -1;
+  char* it = buffer;
+  for(size_t i=0; i<count; i++){
+    int length = key_encode(pane, get(keys, i), it);
+    if(length > 0)
+      it += length;
+  }
+  int ret = tym_i_pts_send(pane, size, buffer);
+  free(buffer);
+  return ret;
+}
+
+static uint_least16_t get_key(const void* keys, size_t i){
+  return ((const uint_least16_t*)keys)[i];
+}
+
+static uint_least16_t get_char(const void* keys, size_t i){
+  return ((const unsigned char*)keys)[i];
+}
+
+/**
+ * \see tym_pane_send_key
+ */
+int tym_i_pts_send_key(struct tym_i_pane_internal* pane, uint_least16_t key){
+  if(!pane){
+    errno = EINVAL;
+    return -1;
+  }
+  char sequence[TYM_I_KEY_SEQUENCE_MAX];
+  int length = key_encode(pane, key, sequence);
+  if(length == -1){
+    errno = EINVAL;
+    return -1;
+  }
+  return tym_i_pts_send(pane, length, sequence);
 }
 
 /**
  * \see tym_pane_send_keys
  */
 int tym_i_pts_send_keys(struct tym_i_pane_internal* pane, size_t count, const uint_least16_t keys[count]){
-  for(size_t i=0; i<count; i++)
-    tym_i_pts_send_key(pane, keys[i]);
-  return 0;
+  if(!pane){
+    errno = EINVAL;
+    return -1;
+  }
+  return send_key_list(pane, count, keys, get_key);
 }
 
 /**
  * \see tym_pane_type
  */
 int tym_i_pts_type(struct tym_i_pane_internal* pane, size_t count, const char keys[count]){
-  for(size_t i=0; i<count; i++)
-    tym_i_pts_send_key(pane, keys[i]);
+  if(!pane){
+    errno = EINVAL;
+    return -1;
+  }
+  return send_key_list(pane, count, keys, get_char);
+}
+
+/**
+ * Paste text. Line breaks are sent as carriage returns, and in bracketed paste mode,
+ * the text is enclosed in CSI 200 ~ and CSI 201 ~. An end marker in the text itself is removed,
+ * it would let the program treat the remainder of the text as typed.
+ *
+ * The text is passed on in chunks, only as much of it as fits into the send queue is queued.
+ * If not all of it could be passed on right away, a copy of the rest is kept,
+ * and tym_i_pts_flush passes on more of it as the queue drains, see paste_fill.
+ * The markers are always sent, even if the queue is full or the rest of the text couldn't be passed on.
+ * The lock of the pane has to be held.
+ *
+ * \see tym_pane_paste
+ */
+int tym_i_pts_paste(struct tym_i_pane_internal* pane, size_t size, const char data[size]){
+  static const char start[] = CSI "200~";
+  if(!pane){
+    errno = EINVAL;
+    return -1;
+  }
+  if(pane->paste.text){
+    errno = EBUSY;
+    return -1;
+  }
+  if(!size)
+    return 0;
+  if(pane->bracketed_paste && send_data(pane, sizeof(start) - 1, start, false) == -1)
+    return -1;
+  pane->paste = (struct tym_i_paste){
+    .text = data,
+    .size = size,
+    .bracketed = pane->bracketed_paste
+  };
+  if(paste_fill(pane) == -1)
+    return -1;
+  if(!pane->paste.text)
+    return 0;
+  // The caller's text can't be used after this returns, keep a copy of the rest of it
+  char* buffer = malloc(pane->paste.size);
+  if(!buffer){
+    paste_end(pane);
+    errno = ENOMEM;
+    return -1;
+  }
+  memcpy(buffer, pane->paste.text + pane->paste.offset, pane->paste.size);
+  pane->paste.text = pane->paste.buffer = buffer;
+  pane->paste.offset = 0;
   return 0;
 }
 
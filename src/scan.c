@@ -0,0 +1,79 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <internal/scan.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TYM_I_SCAN_X86
+#include <immintrin.h>
+#endif
+
+/** \file */
+
+/** Check if a byte is a printable ascii character */
+static inline bool is_printable_ascii(unsigned char c){
+  return c >= 0x20 && c < 0x7F;
+}
+
+/** The fallback for CPUs without any supported vector instructions */
+static size_t scan_printable_ascii_scalar(size_t length, const unsigned char data[length]){
+  size_t i = 0;
+  while(i < length && is_printable_ascii(data[i]))
+    i++;
+  return i;
+}
+
+#ifdef TYM_I_SCAN_X86
+
+/**
+ * Compare 16 bytes at a time. As signed bytes, everything from 0x80 on is negative,
+ * so checking for 0x1F < c < 0x7F takes only two comparisons.
+ */
+__attribute__((target("sse2")))
+static size_t scan_printable_ascii_sse2(size_t length, const unsigned char data[length]){
+  const __m128i low = _mm_set1_epi8(0x1F);
+  const __m128i high = _mm_set1_epi8(0x7F);
+  size_t i = 0;
+  for(; i + 16 <= length; i += 16){
+    __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+    __m128i ok = _mm_and_si128(_mm_cmpgt_epi8(v, low), _mm_cmplt_epi8(v, high));
+    unsigned mask = ~(unsigned)_mm_movemask_epi8(ok) & 0xFFFF;
+    if(mask)
+      return i + __builtin_ctz(mask);
+  }
+  return i + scan_printable_ascii_scalar(length - i, data + i);
+}
+
+/** The same as scan_printable_ascii_sse2, but 32 bytes at a time. */
+__attribute__((target("avx2")))
+static size_t scan_printable_ascii_avx2(size_t length, const unsigned char data[length]){
+  const __m256i low = _mm256_set1_epi8(0x1F);
+  const __m256i high = _mm256_set1_epi8(0x7F);
+  size_t i = 0;
+  for(; i + 32 <= length; i += 32){
+    __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+    __m256i ok = _mm256_and_si256(_mm256_cmpgt_epi8(v, low), _mm256_cmpgt_epi8(high, v));
+    unsigned mask = ~(unsigned)_mm256_movemask_epi8(ok);
+    if(mask)
+      return i + __builtin_ctz(mask);
+  }
+  return i + scan_printable_ascii_sse2(length - i, data + i);
+}
+
+#endif
+
+size_t (*tym_i_scan_printable_ascii)(size_t length, const unsigned char data[length]) = scan_printable_ascii_scalar;
+
+static void init(void) __attribute__((constructor,used));
+static void init(void){
+#ifdef TYM_I_SCAN_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")){
+    tym_i_scan_printable_ascii = scan_printable_ascii_avx2;
+  }else if(__builtin_cpu_supports("sse2")){
+    tym_i_scan_printable_ascii = scan_printable_ascii_sse2;
+  }
+#endif
+}
@@ -0,0 +1,568 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <internal/main.h>
+#include <internal/worker.h>
+#include <internal/pane.h>
+#include <internal/screen.h>
+#include <internal/backend.h>
+#include <internal/utf8.h>
+
+/** \file */
+
+static inline bool color_equal(const struct tym_i_termcolor* a, const struct tym_i_termcolor* b){
+  return a->index == b->index && a->red == b->red && a->green == b->green && a->blue == b->blue;
+}
+
+static inline bool format_equal(const struct tym_i_character_format* a, const struct tym_i_character_format* b){
+  return a->attribute == b->attribute && color_equal(&a->fgcolor, &b->fgcolor) && color_equal(&a->bgcolor, &b->bgcolor);
+}
+
+/** A FNV-1a hash of a character format */
+static uint32_t format_hash(const struct tym_i_character_format* format){
+  const unsigned char data[] = {
+    format->attribute, format->attribute >> 8,
+    format->fgcolor.index, format->fgcolor.red, format->fgcolor.green, format->fgcolor.blue,
+    format->bgcolor.index, format->bgcolor.red, format->bgcolor.green, format->bgcolor.blue,
+  };
+  uint32_t hash = 2166136261u;
+  for(size_t i=0; i<sizeof(data); i++)
+    hash = (hash ^ data[i]) * 16777619u;
+  return hash;
+}
+
+/** Find the entry of the hash table where a format is or should be stored */
+static uint32_t* style_lookup(const struct tym_i_style_table* table, const struct tym_i_character_format* format){
+  size_t mask = table->capacity * 2 - 1;
+  size_t i = format_hash(format) & mask;
+  while(table->index[i] && !format_equal(&table->format[table->index[i]-1], format))
+    i = (i + 1) & mask;
+  return &table->index[i];
+}
+
+/** Rebuild the hash table of the style table */
+static int style_rehash(struct tym_i_style_table* table, size_t capacity){
+  uint32_t* index = calloc(capacity * 2, sizeof(*index));
+  if(!index)
+    return -1;
+  free(table->index);
+  table->index = index;
+  table->capacity = capacity;
+  for(size_t i=0; i<table->count; i++)
+    *style_lookup(table, &table->format[i]) = i + 1;
+  return 0;
+}
+
+/** Make space for more character formats. Fails with ENOSPC if the table has already reached TYM_I_STYLE_MAX. */
+static int style_grow(struct tym_i_style_table* table){
+  if(table->capacity >= TYM_I_STYLE_MAX){
+    errno = ENOSPC;
+    return -1;
+  }
+  size_t capacity = table->capacity ? table->capacity * 2 : 16;
+  if(capacity > TYM_I_STYLE_MAX)
+    capacity = TYM_I_STYLE_MAX;
+  struct tym_i_character_format* format = realloc(table->format, capacity * sizeof(*format));
+  if(!format)
+    return -1;
+  table->format = format;
+  if(!table->count){
+    table->format[0] = tym_i_default_character_format;
+    table->count = 1;
+  }
+  return style_rehash(table, capacity);
+}
+
+/**
+ * Remove all character formats which aren't used by any cell anymore.
+ * The remaining ones are renumbered, and the cells are updated accordingly.
+ */
+static void style_collect(struct tym_i_pane_internal* pane){
+  struct tym_i_style_table* table = &pane->style;
+  uint16_t* map = calloc(table->count, sizeof(*map));
+  if(!map)
+    return;
+  for(size_t s=0; s<TYM_I_SCREEN_COUNT; s++){
+    const struct tym_i_cell_grid* grid = &pane->screen[s].grid;
+    for(size_t i=0, n=(size_t)grid->size.x*grid->size.y; i<n; i++)
+      map[grid->cell[i].style] = 1;
+  }
+  // The default format keeps index 0
+  map[0] = 0;
+  size_t count = 1;
+  for(size_t i=1; i<table->count; i++){
+    if(!map[i])
+      continue;
+    table->format[count] = table->format[i];
+    map[i] = count++;
+  }
+  for(size_t s=0; s<TYM_I_SCREEN_COUNT; s++){
+    struct tym_i_cell_grid* grid = &pane->screen[s].grid;
+    for(size_t i=0, n=(size_t)grid->size.x*grid->size.y; i<n; i++)
+      grid->cell[i].style = map[grid->cell[i].style];
+  }
+  free(map);
+  TYM_U_LOG(TYM_LOG_DEBUG, "Character formats in use: %zu of %zu\n", count, table->count);
+  table->count = count;
+  table->collected = pane->stats.cells_written;
+  if(style_rehash(table, table->capacity) == -1)
+    TYM_U_PERROR(TYM_LOG_ERROR, "style_rehash failed");
+}
+
+/**
+ * Get the index of a character format in the style table of a pane.
+ * The format is added to the table if it isn't in there yet.
+ * If that isn't possible, the default format is used instead.
+ */
+uint16_t tym_i_style_intern(struct tym_i_pane_internal* pane, const struct tym_i_character_format* format){
+  struct tym_i_style_table* table = &pane->style;
+  if(format_equal(format, &tym_i_default_character_format))
+    return 0;
+  if(table->capacity){
+    uint32_t* entry = style_lookup(table, format);
+    if(*entry)
+      return *entry - 1;
+  }
+  if(table->count >= table->capacity){
+    // Only cells written since the last time can have freed any formats
+    if(table->capacity >= TYM_I_STYLE_MAX && pane->stats.cells_written - table->collected >= TYM_I_STYLE_COLLECT_INTERVAL)
+      style_collect(pane);
+    if(table->count >= table->capacity && (style_grow(table) == -1 || table->count >= table->capacity)){
+      TYM_U_LOG(TYM_LOG_WARN, "Too many different character formats\n");
+      return 0;
+    }
+  }
+  table->format[table->count] = *format;
+  *style_lookup(table, format) = table->count + 1;
+  return table->count++;
+}
+
+/** Get a character format from the style table of a pane. */
+const struct tym_i_character_format* tym_i_style_get(const struct tym_i_pane_internal* pane, uint16_t style){
+  if(style >= pane->style.count)
+    return &tym_i_default_character_format;
+  return &pane->style.format[style];
+}
+
+/** Mark a part of a row as changed, it will be passed to the backend by the next tym_i_pane_render */
+void tym_i_damage_mark(struct tym_i_pane_internal* pane, unsigned y, unsigned start, unsigned end){
+  struct tym_i_damage* damage = &pane->damage;
+  if(y >= damage->rows || start >= end)
+    return;
+  uint64_t bit = (uint64_t)1 << (y % 64);
+  struct tym_i_damage_span* span = &damage->span[y];
+  if(damage->row[y/64] & bit){
+    if(span->start > start)
+      span->start = start;
+    if(span->end < end)
+      span->end = end;
+  }else{
+    damage->row[y/64] |= bit;
+    *span = (struct tym_i_damage_span){ .y = y, .start = start, .end = end };
+  }
+  damage->any = true;
+}
+
+/** Mark the whole pane as changed */
+void tym_i_damage_mark_all(struct tym_i_pane_internal* pane){
+  unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
+  for(unsigned y=0; y<pane->damage.rows; y++)
+    tym_i_damage_mark(pane, y, 0, w);
+}
+
+/**
+ * Record a scroll of a region of the current screen, so tym_i_pane_render can pass it to the backend before the changed rows.
+ * Scrolls of the same region add up. If different regions are scrolled, the scroll isn't passed on until the next render.
+ * The scrolled rows are marked as changed by tym_i_screen_scroll_region either way.
+ */
+void tym_i_damage_scroll(struct tym_i_pane_internal* pane, int n, unsigned top, unsigned bottom){
+  struct tym_i_damage* damage = &pane->damage;
+  if(!n || top >= bottom || damage->scroll_lost)
+    return;
+  if(damage->scroll && (damage->scroll_top != top || damage->scroll_bottom != bottom)){
+    damage->scroll = 0;
+    damage->scroll_lost = true;
+    return;
+  }
+  // Scrolling by more than the height of the region just clears it
+  long m = bottom - top;
+  long scroll = (long)damage->scroll + n;
+  if(scroll > m)
+    scroll = m;
+  if(scroll < -m)
+    scroll = -m;
+  damage->scroll = scroll;
+  damage->scroll_top = top;
+  damage->scroll_bottom = bottom;
+}
+
+/** Resize the damage bitset & spans to the height of the pane. Everything is marked as changed afterwards. */
+static int damage_resize(struct tym_i_pane_internal* pane, unsigned h){
+  struct tym_i_damage* damage = &pane->damage;
+  if(damage->rows != h){
+    uint64_t* row = calloc((h+63)/64, sizeof(*row));
+    struct tym_i_damage_span* span = malloc(h * sizeof(*span));
+    if(h && (!row || !span)){
+      free(row);
+      free(span);
+      return -1;
+    }
+    free(damage->row);
+    free(damage->span);
+    damage->row = row;
+    damage->span = span;
+    damage->rows = h;
+  }
+  tym_i_damage_mark_all(pane);
+  damage->cursor = true;
+  // The scrolled region may not fit the pane anymore, everything is redrawn anyway
+  damage->scroll = 0;
+  return 0;
+}
+
+/**
+ * Pass the changed parts of the pane to the backend, if there are any, and forget about them.
+ * Nothing is done if neither the content nor the cursor position changed.
+ */
+int tym_i_pane_render(struct tym_i_pane_internal* pane){
+  struct tym_i_damage* damage = &pane->damage;
+  int ret = 0;
+  pthread_mutex_lock(&pane->lock);
+  pane->unrendered = 0;
+  if(!damage->any && !damage->cursor)
+    goto done;
+  size_t count = 0;
+  if(damage->any){
+    // Move the spans of the changed rows to the start of the span array, count <= y, so this doesn't overwrite anything still needed.
+    for(unsigned i=0, n=(damage->rows+63)/64; i<n; i++){
+      uint64_t bits = damage->row[i];
+      damage->row[i] = 0;
+      while(bits){
+        unsigned y = i * 64 + __builtin_ctzll(bits);
+        bits &= bits - 1;
+        damage->span[count++] = damage->span[y];
+      }
+    }
+  }
+  damage->any = false;
+  damage->cursor = false;
+  int scroll = damage->scroll;
+  damage->scroll = 0;
+  damage->scroll_lost = false;
+  pane->stats.refreshes++;
+  uint64_t start = tym_i_trace_begin();
+  pthread_mutex_lock(&tym_i_backend_lock);
+  // The scroll hint has to reach the backend before the rows, which already show the scrolled content
+  if(scroll){
+    unsigned h = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_VERTICAL);
+    if(damage->scroll_top == 0 && damage->scroll_bottom == h){
+      ret = tym_i_backend->pane_scroll(pane, scroll);
+    }else{
+      ret = tym_i_backend->pane_scroll_region(pane, scroll, damage->scroll_top, damage->scroll_bottom);
+    }
+  }
+  if(ret != -1)
+    ret = tym_i_backend->pane_render(pane, count, damage->span);
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  tym_i_trace_end(pane, TYM_I_TRACE_RENDER, start);
+done:
+  pthread_mutex_unlock(&pane->lock);
+  return ret;
+}
+
+/**
+ * Change the size of the grids of the screens to the size of the pane.
+ * The content in the top left is kept, new cells are empty.
+ */
+int tym_i_screen_resize(struct tym_i_pane_internal* pane){
+  int ret = 0;
+  unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
+  unsigned h = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_VERTICAL);
+  for(size_t s=0; s<TYM_I_SCREEN_COUNT; s++){
+    struct tym_i_cell_grid* grid = &pane->screen[s].grid;
+    if(grid->size.x == w && grid->size.y == h)
+      continue;
+    struct tym_i_cell* cell = 0;
+    unsigned* row = 0;
+    if(w && h){
+      cell = calloc((size_t)w * h, sizeof(*cell));
+      row = malloc(h * sizeof(*row));
+      if(!cell || !row){
+        TYM_U_PERROR(TYM_LOG_ERROR, "calloc failed");
+        free(cell);
+        free(row);
+        ret = -1;
+        continue;
+      }
+      for(unsigned y=0; y<h; y++)
+        row[y] = y;
+      unsigned mw = grid->size.x < w ? grid->size.x : w;
+      unsigned mh = grid->size.y < h ? grid->size.y : h;
+      for(unsigned y=0; y<mh; y++)
+        memcpy(cell + (size_t)y * w, tym_i_screen_line(&pane->screen[s], y), mw * sizeof(*cell));
+    }
+    free(grid->cell);
+    free(grid->row);
+    grid->cell = cell;
+    grid->row = row;
+    grid->first = 0;
+    grid->size = cell ? (struct tym_i_cell_position){ .x = w, .y = h } : (struct tym_i_cell_position){0};
+  }
+  if(damage_resize(pane, h) == -1){
+    TYM_U_PERROR(TYM_LOG_ERROR, "damage_resize failed");
+    ret = -1;
+  }
+  return ret;
+}
+
+/** Free the grids and the style table of a pane */
+void tym_i_screen_free(struct tym_i_pane_internal* pane){
+  for(size_t s=0; s<TYM_I_SCREEN_COUNT; s++){
+    free(pane->screen[s].grid.cell);
+    free(pane->screen[s].grid.row);
+    pane->screen[s].grid = (struct tym_i_cell_grid){0};
+  }
+  free(pane->style.format);
+  free(pane->style.index);
+  pane->style = (struct tym_i_style_table){0};
+  free(pane->damage.row);
+  free(pane->damage.span);
+  pane->damage = (struct tym_i_damage){0};
+}
+
+/** Reverse the order of the lines from top to bottom in the row ring */
+static void ring_reverse(struct tym_i_cell_grid* grid, unsigned top, unsigned bottom){
+  while(top + 1 < bottom){
+    unsigned* a = tym_i_screen_ring_entry(grid, top++);
+    unsigned* b = tym_i_screen_ring_entry(grid, --bottom);
+    unsigned t = *a;
+    *a = *b;
+    *b = t;
+  }
+}
+
+/**
+ * Move the rows of a region of the grid of the current screen up (n>0) or down (n<0) and clear the rows which became free.
+ * No cells are moved. If the region is the whole screen, only the start of the row ring changes,
+ * otherwise, the row indices of the region are rotated.
+ */
+void tym_i_screen_scroll_region(struct tym_i_pane_internal* pane, int n, unsigned top, unsigned bottom){
+  struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
+  struct tym_i_cell_grid* grid = &screen->grid;
+  if(bottom > grid->size.y)
+    bottom = grid->size.y;
+  if(!n || top >= bottom)
+    return;
+  unsigned m = bottom - top;
+  unsigned k = (unsigned)abs(n) < m ? (unsigned)abs(n) : m;
+  if(k < m){
+    unsigned shift = n > 0 ? k : m - k;
+    if(m == grid->size.y){
+      grid->first += shift;
+      if(grid->first >= grid->size.y)
+        grid->first -= grid->size.y;
+    }else{
+      ring_reverse(grid, top, top + shift);
+      ring_reverse(grid, top + shift, bottom);
+      ring_reverse(grid, top, bottom);
+    }
+  }
+  unsigned start = n > 0 ? bottom - k : top;
+  for(unsigned y=start; y<start+k; y++)
+    memset(tym_i_screen_line(screen, y), 0, grid->size.x * sizeof(*grid->cell));
+  for(unsigned y=top; y<bottom; y++)
+    tym_i_damage_mark(pane, y, 0, grid->size.x);
+}
+
+/** Draw a part of a row of the current screen from the grid using pane_set_character */
+int tym_i_screen_draw(struct tym_i_pane_internal* pane, unsigned y, unsigned start, unsigned end){
+  const struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
+  const struct tym_i_cell_grid* grid = &screen->grid;
+  if(y >= grid->size.y)
+    return 0;
+  if(end > grid->size.x)
+    end = grid->size.x;
+  const struct tym_i_cell* line = tym_i_screen_line(screen, y);
+  for(unsigned x=start; x<end; x++){
+    char utf8[TYM_I_UTF8_CHARACTER_MAX_BYTE_COUNT+1] = {0};
+    memcpy(utf8, line[x].glyph, sizeof(line[x].glyph));
+    size_t length = strlen(utf8);
+    if(!length)
+      utf8[0] = ' ';
+    if(tym_i_backend->pane_set_character(pane, (struct tym_i_cell_position){.x=x,.y=y}, *tym_i_style_get(pane, line[x].style), length, utf8, false) == -1)
+      return -1;
+  }
+  return 0;
+}
+
+/** Store a character in a cell */
+static inline void cell_set(struct tym_i_cell* cell, uint16_t style, size_t length, const char utf8[length]){
+  if(length > sizeof(cell->glyph))
+    length = 0;
+  memcpy(cell->glyph, utf8, length);
+  memset(cell->glyph + length, 0, sizeof(cell->glyph) - length);
+  cell->style = style;
+}
+
+/** Set a character on the current screen, and tell the backend about it. */
+int tym_i_pane_set_character(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t length, const char utf8[length+1],
+  bool insert
+){
+  struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
+  struct tym_i_cell_grid* grid = &screen->grid;
+  if(position.x < grid->size.x && position.y < grid->size.y){
+    struct tym_i_cell* line = tym_i_screen_line(screen, position.y);
+    if(insert)
+      memmove(line + position.x + 1, line + position.x, (grid->size.x - position.x - 1) * sizeof(*line));
+    cell_set(line + position.x, tym_i_style_intern(pane, &format), length, utf8);
+    pane->stats.cells_written++;
+    tym_i_damage_mark(pane, position.y, position.x, insert ? grid->size.x : position.x + 1);
+  }
+  if(tym_i_worker_count)
+    return 0;
+  pthread_mutex_lock(&tym_i_backend_lock);
+  int ret = tym_i_backend->pane_set_character(pane, position, format, length, utf8, insert);
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  return ret;
+}
+
+/** Set a run of characters with the same format in a row of the current screen, and tell the backend about it. */
+int tym_i_pane_set_text_run(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t count, size_t length, const char utf8[length]
+){
+  struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
+  struct tym_i_cell_grid* grid = &screen->grid;
+  unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
+  if(position.x >= w || !count)
+    return 0;
+  if(count > w - position.x)
+    count = w - position.x;
+  if(position.x < grid->size.x && position.y < grid->size.y){
+    struct tym_i_cell* line = tym_i_screen_line(screen, position.y);
+    uint16_t style = tym_i_style_intern(pane, &format);
+    const char* it = utf8;
+    size_t rest = length;
+    unsigned x = position.x;
+    for(size_t i=0; i<count && rest && x<grid->size.x; i++, x++){
+      int n = tym_i_utf8_length(*it);
+      if(n <= 0 || (size_t)n > rest)
+        n = 1;
+      cell_set(line + x, style, n, it);
+      it += n;
+      rest -= n;
+    }
+    pane->stats.cells_written += x - position.x;
+    tym_i_damage_mark(pane, position.y, position.x, x);
+  }
+  if(tym_i_worker_count)
+    return 0;
+  pthread_mutex_lock(&tym_i_backend_lock);
+  int ret = tym_i_backend->pane_set_text_run(pane, position, format, count, length, utf8);
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  return ret;
+}
+
+/** Set an area of the grid, the area is the same as for pane_set_area_to_character */
+static void screen_set_area(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position start,
+  struct tym_i_cell_position end,
+  bool block,
+  const struct tym_i_character_format* format,
+  size_t length, const char utf8[length]
+){
+  struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
+  struct tym_i_cell_grid* grid = &screen->grid;
+  unsigned w = grid->size.x;
+  unsigned h = grid->size.y;
+  if(h == 0 || w == 0)
+    return;
+  if(end.x > w)
+    end.x = w;
+  if(end.y >= h)
+    end.y = h-1;
+  uint16_t style = tym_i_style_intern(pane, format);
+  for(unsigned y=start.y; y<=end.y; y++){
+    struct tym_i_cell* line = tym_i_screen_line(screen, y);
+    unsigned e = (block || y == end.y) ? end.x : w;
+    for(unsigned x=start.x; x<e; x++)
+      cell_set(line + x, style, length, utf8);
+    if(e > start.x)
+      pane->stats.cells_written += e - start.x;
+    tym_i_damage_mark(pane, y, start.x, e);
+    if(!block)
+      start.x = 0;
+  }
+}
+
+/** Set an area of the current screen to the same character, and tell the backend about it. */
+int tym_i_pane_set_area_to_character(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position start,
+  struct tym_i_cell_position end,
+  bool block,
+  struct tym_i_character_format format,
+  size_t length, const char utf8[length+1]
+){
+  screen_set_area(pane, start, end, block, &format, length, utf8);
+  if(tym_i_worker_count)
+    return 0;
+  pthread_mutex_lock(&tym_i_backend_lock);
+  int ret = tym_i_backend->pane_set_area_to_character(pane, start, end, block, format, length, utf8);
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  return ret;
+}
+
+/** Erase an area of the current screen, and tell the backend about it. */
+int tym_i_pane_erase_area(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position start,
+  struct tym_i_cell_position end,
+  bool block,
+  struct tym_i_character_format format
+){
+  screen_set_area(pane, start, end, block, &format, 0, "");
+  if(tym_i_worker_count)
+    return 0;
+  pthread_mutex_lock(&tym_i_backend_lock);
+  int ret = tym_i_backend->pane_erase_area(pane, start, end, block, format);
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  return ret;
+}
+
+/** Delete characters of a row of the current screen, and tell the backend about it. */
+int tym_i_pane_delete_characters(struct tym_i_pane_internal* pane, struct tym_i_cell_position position, unsigned n){
+  struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
+  struct tym_i_cell_grid* grid = &screen->grid;
+  unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
+  unsigned h = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_VERTICAL);
+  if(!w || position.y >= h)
+    return 0;
+  if(position.x >= w)
+    position.x = w - 1;
+  if(n > w - position.x)
+    n = w - position.x;
+  if(position.x < grid->size.x && position.y < grid->size.y){
+    struct tym_i_cell* line = tym_i_screen_line(screen, position.y);
+    unsigned m = n < grid->size.x - position.x ? n : grid->size.x - position.x;
+    memmove(line + position.x, line + position.x + m, (grid->size.x - position.x - m) * sizeof(*line));
+    memset(line + grid->size.x - m, 0, m * sizeof(*line));
+    tym_i_damage_mark(pane, position.y, position.x, grid->size.x);
+  }
+  if(tym_i_worker_count)
+    return 0;
+  pthread_mutex_lock(&tym_i_backend_lock);
+  int ret = tym_i_backend->pane_delete_characters(pane, position, n);
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  return ret;
+}
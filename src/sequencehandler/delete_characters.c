@@ -3,6 +3,7 @@
 
 #include <errno.h>
 #include <internal/backend.h>
+#include <internal/screen.h>
 #include <internal/pane.h>
 
 int tym_i_csq_delete_characters(struct tym_i_pane_internal* pane){
@@ -14,6 +15,6 @@ int tym_i_csq_delete_characters(struct tym_i_pane_internal* pane){
   if(pane->sequence.integer_count)
     n = pane->sequence.integer[0];
   if(n == 0) n = 1;
-  tym_i_backend->pane_delete_characters(pane, pane->screen[pane->current_screen].cursor, n);
+  tym_i_pane_delete_characters(pane, pane->screen[pane->current_screen].cursor, n);
   return 0;
 }
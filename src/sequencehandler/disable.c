@@ -31,6 +31,7 @@ int tym_i_csq_disable(struct tym_i_pane_internal* pane){
       );
     } break;
     case TYM_I_DSDR_APPLICATION_KEYPAD: screen->keypad_mode = TYM_I_KEYPAD_MODE_NORMAL; break;
+    case TYM_I_DSDR_BRACKETED_PASTE: pane->bracketed_paste = false; break;
   }
   return 0;
 }
@@ -4,6 +4,7 @@
 #include <errno.h>
 #include <internal/pane.h>
 #include <internal/backend.h>
+#include <internal/screen.h>
 
 int tym_i_csq_erase_characters(struct tym_i_pane_internal* pane){
   size_t n = 1;
@@ -20,6 +21,6 @@ int tym_i_csq_erase_characters(struct tym_i_pane_internal* pane){
     .x = ((unsigned long)screen->cursor.x + n) % w,
     .y = screen->cursor.y + ((unsigned long)screen->cursor.x + n) / w
   };
-  tym_i_backend->pane_erase_area(pane, screen->cursor, end, false, screen->character_format);
+  tym_i_pane_erase_area(pane, screen->cursor, end, false, screen->character_format);
   return 0;
 }
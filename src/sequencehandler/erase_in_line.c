@@ -4,6 +4,7 @@
 #include <errno.h>
 #include <internal/pane.h>
 #include <internal/backend.h>
+#include <internal/screen.h>
 
 int tym_i_csq_erase_in_line(struct tym_i_pane_internal* pane){
   if(pane->sequence.integer_count > 1){
@@ -15,9 +16,9 @@ int tym_i_csq_erase_in_line(struct tym_i_pane_internal* pane){
     pane->sequence.integer[0] = 0;
   unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
   switch(pane->sequence.integer[0]){
-    case 0: tym_i_backend->pane_erase_area(pane, screen->cursor, (struct tym_i_cell_position){.y=screen->cursor.y,.x=w}, false, screen->character_format); break;
-    case 1: tym_i_backend->pane_erase_area(pane, (struct tym_i_cell_position){.y=screen->cursor.y,.x=0}, (struct tym_i_cell_position){.y=screen->cursor.y,.x=screen->cursor.x+1}, false, screen->character_format); break;
-    case 2: tym_i_backend->pane_erase_area(pane, (struct tym_i_cell_position){.y=screen->cursor.y,.x=0}, (struct tym_i_cell_position){.y=screen->cursor.y,.x=w}, false, screen->character_format); break;
+    case 0: tym_i_pane_erase_area(pane, screen->cursor, (struct tym_i_cell_position){.y=screen->cursor.y,.x=w}, false, screen->character_format); break;
+    case 1: tym_i_pane_erase_area(pane, (struct tym_i_cell_position){.y=screen->cursor.y,.x=0}, (struct tym_i_cell_position){.y=screen->cursor.y,.x=screen->cursor.x+1}, false, screen->character_format); break;
+    case 2: tym_i_pane_erase_area(pane, (struct tym_i_cell_position){.y=screen->cursor.y,.x=0}, (struct tym_i_cell_position){.y=screen->cursor.y,.x=w}, false, screen->character_format); break;
     default: errno = ENOSYS; return -1;
   }
   return 0;
@@ -4,6 +4,7 @@
 #include <errno.h>
 #include <internal/pane.h>
 #include <internal/backend.h>
+#include <internal/screen.h>
 
 int tym_i_csq_insert_character(struct tym_i_pane_internal* pane){
   if(pane->sequence.integer_count > 1){
@@ -28,6 +29,6 @@ int tym_i_csq_insert_character(struct tym_i_pane_internal* pane){
   if(n > w - x)
     n = w - x;
   while(n--)
-    tym_i_backend->pane_set_character(pane, (struct tym_i_cell_position){.x=x,.y=y}, screen->character_format, 1, " ", true);
+    tym_i_pane_set_character(pane, (struct tym_i_cell_position){.x=x,.y=y}, screen->character_format, 1, " ", true);
   return 0;
 }
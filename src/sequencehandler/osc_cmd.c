@@ -0,0 +1,63 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <internal/pane.h>
+#include <internal/parser.h>
+
+enum {
+  ICON_NAME_AND_TITLE = 0,
+  ICON_NAME = 1,
+  TITLE = 2
+};
+
+static bool is_title(const struct tym_i_pane_internal* pane){
+  int command = pane->sequence.integer[0];
+  return command == ICON_NAME_AND_TITLE || command == TITLE;
+}
+
+/** Collect the title in tym_i_pane_internal::title_pending, it's truncated to TYM_I_MAX_TITLE_LENGTH bytes. */
+void tym_i_csq_osc_cmd_string(struct tym_i_pane_internal* pane, enum tym_i_string_event event, size_t size, const char data[size]){
+  if(!is_title(pane))
+    return;
+  switch(event){
+    case TYM_I_STRING_START:
+    case TYM_I_STRING_ABORT: {
+      free(pane->title_pending);
+      pane->title_pending = 0;
+      pane->title_pending_length = 0;
+    } break;
+    case TYM_I_STRING_DATA: {
+      if(size > TYM_I_MAX_TITLE_LENGTH - pane->title_pending_length)
+        size = TYM_I_MAX_TITLE_LENGTH - pane->title_pending_length;
+      if(!size)
+        return;
+      char* title = realloc(pane->title_pending, pane->title_pending_length + size + 1);
+      if(!title)
+        return;
+      memcpy(title + pane->title_pending_length, data, size);
+      pane->title_pending = title;
+      pane->title_pending_length += size;
+    } break;
+  }
+}
+
+int tym_i_csq_osc_cmd(struct tym_i_pane_internal* pane){
+  switch(pane->sequence.integer[0]){
+    case ICON_NAME_AND_TITLE:
+    case TITLE: {
+      if(pane->title_pending)
+        pane->title_pending[pane->title_pending_length] = 0;
+      free(pane->title);
+      pane->title = pane->title_pending;
+      pane->title_pending = 0;
+      pane->title_pending_length = 0;
+    } return 0;
+    case ICON_NAME: return 0;
+  }
+  errno = ENOENT;
+  return -1;
+}
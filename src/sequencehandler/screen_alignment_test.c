@@ -3,6 +3,7 @@
 
 #include <errno.h>
 #include <internal/backend.h>
+#include <internal/screen.h>
 #include <internal/pane.h>
 
 
@@ -14,6 +15,6 @@ int tym_i_csq_screen_alignment_test(struct tym_i_pane_internal* pane){
   struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
   unsigned w = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_HORIZONTAL);
   unsigned h = TYM_RECT_SIZE(pane->absolute_position, CHARFIELD, TYM_AXIS_VERTICAL);
-  tym_i_backend->pane_set_area_to_character(pane, (struct tym_i_cell_position){0,0}, (struct tym_i_cell_position){.x=w,.y=h}, true, screen->character_format, 1, "E");
+  tym_i_pane_set_area_to_character(pane, (struct tym_i_cell_position){0,0}, (struct tym_i_cell_position){.x=w,.y=h}, true, screen->character_format, 1, "E");
   return 0;
 }
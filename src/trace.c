@@ -0,0 +1,179 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <internal/main.h>
+#include <internal/pane.h>
+#include <internal/trace.h>
+#include <libttymultiplex.h>
+
+/** \file */
+
+/** A span, as kept for tym_trace_dump */
+struct tym_i_trace_event {
+  /** The start time in nanoseconds */
+  uint64_t start;
+  /** The duration in nanoseconds */
+  uint64_t duration;
+  /** The id of the pane, or 0 for spans of the main loop */
+  int pane;
+  enum tym_i_trace_phase phase;
+};
+
+/** A copy of the stats of a pane, see tym_trace_dump */
+struct tym_i_trace_pane_stats {
+  int pane;
+  struct tym_i_trace_stats stats[TYM_I_TRACE_PHASE_COUNT];
+};
+
+static const char* phase_name[] = {
+#define X(ID, NAME) #NAME,
+  TYM_I_TRACE_PHASE_LIST(X)
+#undef X
+};
+
+bool tym_i_trace_enabled;
+
+/** Protects event_list, event_count & main_stats */
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+/** The most recent spans, used as a ring */
+static struct tym_i_trace_event event_list[TYM_I_TRACE_EVENT_MAX];
+/** The number of spans added to event_list so far */
+static uint64_t event_count;
+/** The spans which don't belong to a pane */
+static struct tym_i_trace_stats main_stats[TYM_I_TRACE_PHASE_COUNT];
+
+/** The current time of the monotonic clock in nanoseconds */
+uint64_t tym_i_trace_now(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void stats_add(struct tym_i_trace_stats* stats, uint64_t duration){
+  stats->count++;
+  stats->total += duration;
+  if(stats->max < duration)
+    stats->max = duration;
+}
+
+/**
+ * End a span started using tym_i_trace_begin. If pane isn't a null pointer, the span is added
+ * to the stats of the pane, and its lock has to be held. Escape sequences are only summed up,
+ * there are too many of them to keep every span.
+ */
+void tym_i_trace_end(struct tym_i_pane_internal* pane, enum tym_i_trace_phase phase, uint64_t start){
+  if(!start)
+    return;
+  uint64_t duration = tym_i_trace_now() - start;
+  if(pane)
+    stats_add(&pane->trace[phase], duration);
+  if(pane && phase == TYM_I_TRACE_SEQUENCE)
+    return;
+  pthread_mutex_lock(&trace_lock);
+  if(!pane)
+    stats_add(&main_stats[phase], duration);
+  event_list[event_count++ % TYM_I_TRACE_EVENT_MAX] = (struct tym_i_trace_event){
+    .start = start,
+    .duration = duration,
+    .pane = pane ? pane->id : 0,
+    .phase = phase,
+  };
+  pthread_mutex_unlock(&trace_lock);
+}
+
+int tym_set_tracing(bool enable){
+  __atomic_store_n(&tym_i_trace_enabled, enable, __ATOMIC_RELAXED);
+  return 0;
+}
+
+static void write_stats(FILE* f, const char* name, const struct tym_i_trace_stats stats[TYM_I_TRACE_PHASE_COUNT]){
+  fprintf(f, "\"%s\":{", name);
+  for(size_t i=0; i<TYM_I_TRACE_PHASE_COUNT; i++){
+    fprintf(f, "%s\"%s\":{\"count\":%llu,\"total_ns\":%llu,\"max_ns\":%llu}",
+      i ? "," : "", phase_name[i],
+      (unsigned long long)stats[i].count,
+      (unsigned long long)stats[i].total,
+      (unsigned long long)stats[i].max
+    );
+  }
+  fprintf(f, "}");
+}
+
+int tym_trace_dump(int fd){
+  int ret = -1;
+  struct tym_i_trace_event* events = 0;
+  struct tym_i_trace_pane_stats* panes = 0;
+  size_t pane_count = 0;
+  struct tym_i_trace_stats loop_stats[TYM_I_TRACE_PHASE_COUNT];
+  FILE* f = 0;
+  // Copy everything first, the file descriptor may block
+  pthread_mutex_lock(&tym_i_lock);
+  for(struct tym_i_pane_internal* it=tym_i_pane_list_start; it; it=it->next)
+    pane_count++;
+  if(pane_count && !(panes = calloc(pane_count, sizeof(*panes)))){
+    pthread_mutex_unlock(&tym_i_lock);
+    goto error;
+  }
+  pane_count = 0;
+  for(struct tym_i_pane_internal* it=tym_i_pane_list_start; it; it=it->next){
+    pthread_mutex_lock(&it->lock);
+    panes[pane_count].pane = it->id;
+    memcpy(panes[pane_count].stats, it->trace, sizeof(it->trace));
+    pthread_mutex_unlock(&it->lock);
+    pane_count++;
+  }
+  pthread_mutex_unlock(&tym_i_lock);
+  events = malloc(sizeof(event_list));
+  if(!events)
+    goto error;
+  pthread_mutex_lock(&trace_lock);
+  uint64_t count = event_count < TYM_I_TRACE_EVENT_MAX ? event_count : TYM_I_TRACE_EVENT_MAX;
+  for(uint64_t i=0; i<count; i++)
+    events[i] = event_list[(event_count - count + i) % TYM_I_TRACE_EVENT_MAX];
+  memcpy(loop_stats, main_stats, sizeof(loop_stats));
+  pthread_mutex_unlock(&trace_lock);
+
+  int dfd = dup(fd);
+  if(dfd == -1)
+    goto error;
+  f = fdopen(dfd, "w");
+  if(!f){
+    close(dfd);
+    goto error;
+  }
+  fprintf(f, "{\"traceEvents\":[\n");
+  fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"libttymultiplex\"}},\n");
+  fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"main loop\"}}");
+  for(size_t i=0; i<pane_count; i++)
+    fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"pane %d\"}}", panes[i].pane, panes[i].pane);
+  for(uint64_t i=0; i<count; i++){
+    fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"libttymultiplex\",\"ph\":\"X\",\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":1,\"tid\":%d}",
+      phase_name[events[i].phase],
+      (unsigned long long)(events[i].start / 1000), (unsigned)(events[i].start % 1000),
+      (unsigned long long)(events[i].duration / 1000), (unsigned)(events[i].duration % 1000),
+      events[i].pane
+    );
+  }
+  fprintf(f, "\n],\n\"displayTimeUnit\":\"ns\",\n\"tymStats\":{");
+  write_stats(f, "main loop", loop_stats);
+  for(size_t i=0; i<pane_count; i++){
+    char name[32];
+    snprintf(name, sizeof(name), "pane %d", panes[i].pane);
+    fprintf(f, ",");
+    write_stats(f, name, panes[i].stats);
+  }
+  fprintf(f, "}}\n");
+  ret = 0;
+error:
+  if(f && fclose(f) == EOF)
+    ret = -1;
+  free(events);
+  free(panes);
+  return ret;
+}
@@ -7,7 +7,8 @@
 
 /** \file */
 
-static int utf8_length(uint8_t b){
+/** Get the number of bytes of a utf-8 sequence from its first byte, or -1 if it isn't a valid first byte */
+int tym_i_utf8_length(uint8_t b){
   if( (b & 0x80) == 0 )
     return 1;
   if( (b & 0xE0) == 0xC0 )
@@ -27,7 +28,7 @@ enum tym_i_utf8_character_state_push_result tym_i_utf8_character_state_push(stru
     errno = EINVAL;
     return TYM_I_UCS_ERROR;
   }
-  int n = utf8_length(state->data[0]);
+  int n = tym_i_utf8_length(state->data[0]);
   if( state->count > TYM_I_UTF8_CHARACTER_MAX_BYTE_COUNT || n <= 0 || state->count >= n ){
     memset(state,0,sizeof(*state));
     n = 0;
@@ -0,0 +1,149 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <internal/main.h>
+#include <internal/pane.h>
+#include <internal/worker.h>
+
+/** \file */
+
+unsigned tym_i_worker_count;
+
+/** Protects the queue and the stop flag. No other lock may be taken while this one is held. */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+/** Signaled when a pane was added to the queue or the workers should stop */
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+/** The panes with pending output, linked using tym_i_pane_internal::worker_next */
+static struct tym_i_pane_internal *queue_start, *queue_end;
+/** Set by tym_i_worker_stop */
+static bool queue_stop;
+
+/** The number of entries in thread_list */
+static size_t thread_count;
+static pthread_t* thread_list;
+
+/** Read & parse the output of a pane, then watch its pseudo terminal master again. */
+static void process(struct tym_i_pane_internal* pane){
+  ssize_t ret = 0;
+  int err = 0;
+  pthread_mutex_lock(&pane->lock);
+  if(!pane->destroyed){
+    ret = tym_i_pane_read(pane);
+    err = errno;
+  }
+  pthread_mutex_unlock(&pane->lock);
+  pthread_mutex_lock(&tym_i_lock);
+  if(!pane->destroyed){
+    if(ret == -1 && err != EAGAIN){
+      tym_i_pollfd_remove(pane->master);
+    }else{
+      tym_i_render_schedule(pane, ret > 0 ? ret : 0);
+      tym_i_pane_flow_control(pane);
+      if(tym_i_pollfd_rearm(pane->master) == -1)
+        TYM_U_PERROR(TYM_LOG_ERROR, "tym_i_pollfd_rearm failed");
+    }
+  }
+  tym_i_pane_unref(pane);
+  pthread_mutex_unlock(&tym_i_lock);
+}
+
+static void* worker(void* ptr){
+  (void)ptr;
+  pthread_mutex_lock(&queue_lock);
+  while(true){
+    while(!queue_stop && !queue_start)
+      pthread_cond_wait(&queue_cond, &queue_lock);
+    if(queue_stop)
+      break;
+    struct tym_i_pane_internal* pane = queue_start;
+    queue_start = pane->worker_next;
+    if(!queue_start)
+      queue_end = 0;
+    pane->worker_next = 0;
+    pthread_mutex_unlock(&queue_lock);
+    process(pane);
+    pthread_mutex_lock(&queue_lock);
+  }
+  pthread_mutex_unlock(&queue_lock);
+  return 0;
+}
+
+/**
+ * Start the workers. This is done by the main loop when it starts.
+ * Returns -1 if not a single worker could be started.
+ */
+int tym_i_worker_start(void){
+  if(!tym_i_worker_count || thread_count)
+    return 0;
+  thread_list = calloc(tym_i_worker_count, sizeof(*thread_list));
+  if(!thread_list)
+    return -1;
+  for(unsigned i=0; i<tym_i_worker_count; i++){
+    int err = pthread_create(&thread_list[thread_count], 0, worker, 0);
+    if(err){
+      errno = err;
+      TYM_U_PERROR(TYM_LOG_WARN, "pthread_create failed");
+      break;
+    }
+    thread_count++;
+  }
+  if(!thread_count){
+    free(thread_list);
+    thread_list = 0;
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Stop the workers and wait for them to finish. This is done by the main loop before it exits.
+ * It mustn't hold tym_i_lock, the workers may be waiting for it. Panes which are still
+ * queued are watched again, they're processed once the main loop is started again.
+ */
+void tym_i_worker_stop(void){
+  pthread_mutex_lock(&queue_lock);
+  queue_stop = true;
+  pthread_cond_broadcast(&queue_cond);
+  pthread_mutex_unlock(&queue_lock);
+  for(size_t i=0; i<thread_count; i++)
+    pthread_join(thread_list[i], 0);
+  free(thread_list);
+  thread_list = 0;
+  thread_count = 0;
+  pthread_mutex_lock(&queue_lock);
+  struct tym_i_pane_internal* it = queue_start;
+  queue_start = 0;
+  queue_end = 0;
+  queue_stop = false;
+  pthread_mutex_unlock(&queue_lock);
+  pthread_mutex_lock(&tym_i_lock);
+  while(it){
+    struct tym_i_pane_internal* pane = it;
+    it = pane->worker_next;
+    pane->worker_next = 0;
+    if(!pane->destroyed)
+      tym_i_pollfd_rearm(pane->master);
+    tym_i_pane_unref(pane);
+  }
+  pthread_mutex_unlock(&tym_i_lock);
+}
+
+/**
+ * Queue a pane whose pseudo terminal master is ready to be read by a worker.
+ * The pane is referenced until it was processed. tym_i_lock has to be held.
+ */
+void tym_i_worker_enqueue(struct tym_i_pane_internal* pane){
+  pane->refcount++;
+  pthread_mutex_lock(&queue_lock);
+  if(queue_end)
+    queue_end->worker_next = pane;
+  else
+    queue_start = pane;
+  queue_end = pane;
+  pthread_cond_signal(&queue_cond);
+  pthread_mutex_unlock(&queue_lock);
+}
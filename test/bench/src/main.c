@@ -0,0 +1,292 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <internal/main.h>
+#include <internal/pane.h>
+#include <internal/parser.h>
+#include <internal/screen.h>
+
+/**
+ * \file
+ *
+ * Throughput benchmarks for the parse & render pipeline.
+ * Every workload is generated in memory and passed to tym_i_pane_parse_buffer
+ * in chunks of the size the main loop reads from the pseudo terminal master.
+ * The changes are rendered using the headless backend.
+ */
+
+enum {
+  /** The size of the chunks passed to the parser, the same as the read buffer of the main loop */
+  CHUNK_SIZE = 4096,
+  /** The size of the generated data of a workload, it's repeated until the total size is reached */
+  WORKLOAD_SIZE = 1024 * 1024,
+};
+
+struct buffer {
+  size_t size;
+  char* data;
+};
+
+struct workload {
+  const char* name;
+  const char* description;
+  void (*generate)(struct buffer* buffer);
+};
+
+/** The number of sequences which have been dispatched so far */
+static unsigned long long sequence_count;
+
+void tym_i_csq_test_hook(const struct tym_i_pane_internal* pane, int ret, const struct tym_i_command_sequence* command){
+  (void)pane;
+  (void)ret;
+  (void)command;
+  sequence_count++;
+}
+
+static unsigned long random_state = 1;
+/** A simple deterministic pseudo random number generator, the workloads must be the same every time */
+static unsigned next_random(void){
+  random_state = random_state * 6364136223846793005ull + 1442695040888963407ull;
+  return random_state >> 33;
+}
+
+static void append(struct buffer* buffer, const char* format, ...) __attribute__((format(printf, 2, 3)));
+static void append(struct buffer* buffer, const char* format, ...){
+  size_t space = WORKLOAD_SIZE - buffer->size;
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buffer->data + buffer->size, space, format, args);
+  va_end(args);
+  if(n > 0 && (size_t)n < space)
+    buffer->size += n;
+  else
+    buffer->size = WORKLOAD_SIZE;
+}
+
+static bool full(const struct buffer* buffer){
+  return buffer->size + 256 >= WORKLOAD_SIZE;
+}
+
+static void random_word(struct buffer* buffer){
+  char word[16];
+  unsigned n = next_random() % 10 + 1;
+  for(unsigned i=0; i<n; i++)
+    word[i] = 'a' + next_random() % 26;
+  word[n] = 0;
+  append(buffer, "%s", word);
+}
+
+/** Lines of plain printable ascii text */
+static void generate_ascii(struct buffer* buffer){
+  while(!full(buffer)){
+    for(unsigned i=0, n=next_random()%12+4; i<n; i++){
+      random_word(buffer);
+      append(buffer, " ");
+    }
+    append(buffer, "\r\n");
+  }
+}
+
+/** Short words, each with different colors and attributes */
+static void generate_sgr(struct buffer* buffer){
+  while(!full(buffer)){
+    for(unsigned i=0, n=next_random()%12+4; i<n; i++){
+      switch(next_random() % 4){
+        case 0: append(buffer, "\033[%um", 30 + next_random() % 8); break;
+        case 1: append(buffer, "\033[1;%u;%um", 30 + next_random() % 8, 40 + next_random() % 8); break;
+        case 2: append(buffer, "\033[38;5;%um", next_random() % 256); break;
+        case 3: append(buffer, "\033[48;2;%u;%u;%um", next_random() % 256, next_random() % 256, next_random() % 256); break;
+      }
+      random_word(buffer);
+      append(buffer, "\033[0m ");
+    }
+    append(buffer, "\r\n");
+  }
+}
+
+/** Full screen redraws using absolute cursor positioning, as done by programs like top */
+static void generate_cursor(struct buffer* buffer){
+  while(!full(buffer)){
+    append(buffer, "\033[H");
+    for(unsigned y=1; y<=24 && !full(buffer); y++){
+      append(buffer, "\033[%u;1H\033[7m%5u\033[0m ", y, next_random() % 100000);
+      for(unsigned i=0; i<6; i++){
+        random_word(buffer);
+        append(buffer, " ");
+      }
+      append(buffer, "\033[K");
+    }
+  }
+}
+
+/** Log output scrolling through a scrolling region below a status line */
+static void generate_scroll(struct buffer* buffer){
+  while(!full(buffer)){
+    append(buffer, "\033[2;24r\033[24;1H");
+    for(unsigned i=0; i<200 && !full(buffer); i++){
+      append(buffer, "\n[%6u.%06u] ", next_random() % 100000, next_random() % 1000000);
+      for(unsigned j=0, n=next_random()%10+2; j<n; j++){
+        random_word(buffer);
+        append(buffer, " ");
+      }
+    }
+    append(buffer, "\033[r\033[1;1H\033[2Kstatus %u", next_random());
+  }
+}
+
+/** A mix of ascii, CJK characters and emoji */
+static void generate_utf8(struct buffer* buffer){
+  static const char* const characters[] = {
+    "中", "文", "字", "符", "日", "本", "語", "한",
+    "ä", "ö", "ü", "é",
+    "\U0001F600", "\U0001F680", "\U0001F389", "\U0001F44D",
+  };
+  while(!full(buffer)){
+    for(unsigned i=0, n=next_random()%30+10; i<n; i++){
+      if(next_random() % 3){
+        append(buffer, "%s", characters[next_random() % (sizeof(characters)/sizeof(*characters))]);
+      }else{
+        random_word(buffer);
+        append(buffer, " ");
+      }
+    }
+    append(buffer, "\r\n");
+  }
+}
+
+/** Random bytes, mostly invalid utf-8 and control characters. Escape sequences are left out, they could contain queries. */
+static void generate_noise(struct buffer* buffer){
+  while(buffer->size < WORKLOAD_SIZE){
+    unsigned char c = next_random();
+    if(c == 0x1B || c == 0x9B || c == 0x9D || c == 0x90)
+      c = '?';
+    buffer->data[buffer->size++] = c;
+  }
+}
+
+static const struct workload workload_list[] = {
+  { "ascii" , "dense printable ascii", generate_ascii },
+  { "sgr"   , "SGR color & attribute churn", generate_sgr },
+  { "cursor", "cursor addressed full screen redraws", generate_cursor },
+  { "scroll", "log scrolling in a scrolling region", generate_scroll },
+  { "utf8"  , "mixed CJK, emoji & ascii utf-8", generate_utf8 },
+  { "noise" , "invalid bytes & control characters", generate_noise },
+};
+enum { WORKLOAD_COUNT = sizeof(workload_list) / sizeof(*workload_list) };
+
+static double now(void){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static struct tym_super_position_rectangle fullscreen = {
+  .edge[TYM_RECT_BOTTOM_RIGHT].type[TYM_P_RATIO].axis = {
+    [TYM_AXIS_HORIZONTAL].value.real = 1,
+    [TYM_AXIS_VERTICAL].value.real = 1,
+  }
+};
+
+static int run(int pane, const struct workload* workload, size_t total, unsigned render_interval){
+  struct buffer buffer = { .data = malloc(WORKLOAD_SIZE) };
+  if(!buffer.data){
+    perror("malloc failed");
+    return -1;
+  }
+  random_state = 1;
+  workload->generate(&buffer);
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane){
+    perror("tym_i_pane_acquire failed");
+    free(buffer.data);
+    return -1;
+  }
+  tym_i_pane_reset(ppane);
+  tym_i_pane_render(ppane);
+  sequence_count = 0;
+  size_t done = 0;
+  unsigned chunk = 0;
+  double start = now();
+  while(done < total){
+    for(size_t offset=0; offset<buffer.size && done<total; offset+=CHUNK_SIZE){
+      size_t n = buffer.size - offset < CHUNK_SIZE ? buffer.size - offset : CHUNK_SIZE;
+      tym_i_pane_parse_buffer(ppane, buffer.data + offset, n);
+      if(++chunk >= render_interval){
+        tym_i_pane_render(ppane);
+        chunk = 0;
+      }
+      done += n;
+    }
+  }
+  tym_i_pane_render(ppane);
+  double time = now() - start;
+  tym_i_pane_release(ppane);
+  free(buffer.data);
+  printf("%-8s %10.2f %14.0f %10.2f   %s\n",
+    workload->name,
+    done / time / (1024 * 1024),
+    sequence_count / time,
+    time * 1e9 / done,
+    workload->description
+  );
+  return 0;
+}
+
+static void usage(const char* name){
+  fprintf(stderr,
+    "Usage: %s [-s MiB] [-r chunks] [workload...]\n"
+    "  -s  The amount of data to process per workload, default 64\n"
+    "  -r  Render every n chunks of %d bytes, default 1\n"
+    "The size of the screen can be set using TM_HEADLESS_SIZE, default 80x24\n"
+    "Workloads:\n", name, CHUNK_SIZE
+  );
+  for(size_t i=0; i<WORKLOAD_COUNT; i++)
+    fprintf(stderr, "  %-8s %s\n", workload_list[i].name, workload_list[i].description);
+}
+
+int main(int argc, char* argv[]){
+  size_t total = 64;
+  unsigned render_interval = 1;
+  int opt;
+  while((opt = getopt(argc, argv, "s:r:h")) != -1){
+    switch(opt){
+      case 's': total = strtoul(optarg, 0, 10); break;
+      case 'r': render_interval = strtoul(optarg, 0, 10); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if(!total || !render_interval){
+    usage(argv[0]);
+    return 1;
+  }
+  total *= 1024 * 1024;
+  setenv("TM_BACKEND", "headless", true);
+  if(tym_init()){
+    perror("tym_init failed");
+    return 1;
+  }
+  int pane = tym_pane_create(&fullscreen);
+  if(pane == -1){
+    perror("tym_pane_create failed");
+    return 1;
+  }
+  printf("%-8s %10s %14s %10s   %s\n", "workload", "MiB/s", "sequences/s", "ns/byte", "description");
+  int ret = 0;
+  for(size_t i=0; i<WORKLOAD_COUNT; i++){
+    bool selected = optind >= argc;
+    for(int j=optind; j<argc; j++)
+      if(!strcmp(argv[j], workload_list[i].name))
+        selected = true;
+    if(selected && run(pane, workload_list + i, total, render_interval) == -1)
+      ret = 1;
+  }
+  tym_shutdown();
+  return ret;
+}
@@ -24,6 +24,7 @@ TERMINFO_BASE = bin/terminfo/
 ABS_TERMINFO_BASE = $(PROJECT_ROOT)/$(TERMINFO_BASE)
 
 HEADERS += $(wildcard include/*.h) $(wildcard include/**/*.h)
+HEADERS += $(wildcard $(TEST_DIR)/common/include/*.h)
 HEADERS += $(wildcard $(PROJECT_ROOT)/*.h) $(wildcard $(PROJECT_ROOT)/include/**/*.h)
 
 ifdef DEBUG
@@ -37,6 +38,7 @@ endif
 CC_OPTS += -std=c99 -Wall -Wextra -pedantic
 CC_OPTS += -D_DEFAULT_SOURCE
 CC_OPTS += -Iinclude
+CC_OPTS += -I$(TEST_DIR)/common/include
 CC_OPTS += -I$(PROJECT_ROOT)/include
 
 CC_OPTS += -DTYM_LOG_PROJECT='"test-$(NAME)"'
@@ -47,6 +49,8 @@ CC_OPTS += -DTYM_I_BACKEND_PRIORITY=100
 LD_OPTS += -ldl -lutil -pthread
 
 OBJS += $(patsubst $(SRC_DIR)/%.c,$(BUILD_DIR)/%.c.o,$(SOURCES))
+# Helpers shared by the tests, in common/src
+OBJS += $(patsubst %.c,$(BUILD_DIR)/common/%.c.o,$(COMMON_SOURCES))
 
 always:
 
@@ -66,6 +70,10 @@ $(BUILD_DIR)/%.c.o: $(SRC_DIR)/%.c $(HEADERS)
 	mkdir -p "$(dir $@)"
 	$(CC) -c -o "$@" $(CC_OPTS) $(CFLAGS) $(CPPFLAGS) "$<"
 
+$(BUILD_DIR)/common/%.c.o: $(TEST_DIR)/common/src/%.c $(HEADERS)
+	mkdir -p "$(dir $@)"
+	$(CC) -c -o "$@" $(CC_OPTS) $(CFLAGS) $(CPPFLAGS) "$<"
+
 $(ABS_LIBTTYMULTIPLEX_BASE_A):
 	$(MAKE) -C "$(PROJECT_ROOT)" "$(LIBTTYMULTIPLEX_BASE_A)"
 
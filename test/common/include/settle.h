@@ -0,0 +1,14 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#ifndef TEST_SETTLE_H
+#define TEST_SETTLE_H
+
+/** \file */
+
+/** How often settle checks a pane, a millisecond apart, before it gives up */
+#define SETTLE_TIMEOUT 10000
+
+void settle(int pane);
+
+#endif
@@ -0,0 +1,36 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <internal/pane.h>
+#include <settle.h>
+
+/**
+ * Wait until everything written to the pane so far was read, parsed and rendered.
+ * The pseudo terminal may need a moment to pass written data on to the master.
+ * The main loop or a worker holds the lock of the pane from before it reads until it's done parsing.
+ * If there are workers, the changes are only drawn once the main loop renders the pane.
+ * This gives up after SETTLE_TIMEOUT checks, so a pane which isn't read anymore fails a check instead of hanging it.
+ */
+void settle(int pane){
+  bool pending = true;
+  usleep(10000);
+  for(unsigned i=0; pending; i++){
+    if(i >= SETTLE_TIMEOUT){
+      fprintf(stderr, "settle: pane %d still has pending output, giving up\n", pane);
+      return;
+    }
+    int n = 0;
+    struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+    if(!ppane || ioctl(ppane->master, FIONREAD, &n) == -1)
+      n = 0;
+    pending = n || (ppane && ppane->damage.any);
+    if(ppane)
+      tym_i_pane_release(ppane);
+    if(pending)
+      usleep(1000);
+  }
+}
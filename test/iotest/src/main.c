@@ -0,0 +1,822 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <termios.h>
+#include <internal/main.h>
+#include <internal/pane.h>
+#include <internal/parser.h>
+#include <internal/backend.h>
+#include <internal/screen.h>
+#include <settle.h>
+
+/**
+ * \file
+ *
+ * Checks of what the program in a pane sees of libttymultiplex, and what it gets to see of the program.
+ * Every check is a function of this program, the check to run is passed as argument.
+ */
+
+enum {
+  /** The maximum number of bytes of a control string passed to its handler at once, see tym_set_string_chunk_size */
+  STRING_CHUNK_SIZE = 1000,
+  /** The number of bytes which may be queued for sending to a pane, see tym_set_send_queue_limit */
+  SEND_QUEUE_LIMIT = 64 * 1024,
+  /** The number of bytes sent to a pane at once by the send queue checks */
+  SEND_CHUNK_SIZE = 1024,
+  /** The maximum number of chunks the send queue checks send before they give up */
+  SEND_CHUNK_MAX = 4096
+};
+
+/** The size of the terminal the backend pretends to draw to, see update_terminal_size_information */
+struct tym_i_cell_position terminal_size = { 80, 24 };
+
+/** What the backend was asked to draw. This is protected by tym_i_backend_lock. */
+struct draw_log {
+  /** The number of characters drawn */
+  size_t characters;
+  /** The number of rows whole panes were scrolled up by, see pane_scroll */
+  long scrolled;
+  /** Set if something was drawn by another thread than the main loop */
+  bool off_main_loop;
+};
+
+struct draw_log draw_log;
+
+struct tym_super_position_rectangle top_pane_coordinates = {
+  .edge[TYM_RECT_BOTTOM_RIGHT].type[TYM_P_RATIO].axis = {
+    [TYM_AXIS_HORIZONTAL].value.real = 1,
+    [TYM_AXIS_VERTICAL].value.real = 1,
+  }
+};
+
+/** The events of the APC strings the pane got, see tym_i_csq_application_program_command_string */
+struct string_log {
+  /** One character per event: S for start, D for data, A for abort, E for the end of the string */
+  char event[64];
+  size_t event_count;
+  /** The data of all the data events */
+  char data[16384];
+  size_t size;
+  /** Set if a data event had more than STRING_CHUNK_SIZE or no bytes */
+  bool bad_chunk;
+};
+
+struct string_log string_log;
+
+static void string_log_event(char event){
+  if(string_log.event_count < sizeof(string_log.event) - 1)
+    string_log.event[string_log.event_count++] = event;
+}
+
+void tym_i_csq_application_program_command_string(struct tym_i_pane_internal* pane, enum tym_i_string_event event, size_t size, const char data[size]){
+  (void)pane;
+  switch(event){
+    case TYM_I_STRING_START: string_log_event('S'); break;
+    case TYM_I_STRING_ABORT: string_log_event('A'); break;
+    case TYM_I_STRING_DATA: {
+      string_log_event('D');
+      if(!size || size > STRING_CHUNK_SIZE)
+        string_log.bad_chunk = true;
+      if(size > sizeof(string_log.data) - string_log.size)
+        size = sizeof(string_log.data) - string_log.size;
+      memcpy(string_log.data + string_log.size, data, size);
+      string_log.size += size;
+    } break;
+  }
+}
+
+int tym_i_csq_application_program_command(struct tym_i_pane_internal* pane){
+  (void)pane;
+  string_log_event('E');
+  return 0;
+}
+
+static int write_all(int fd, size_t size, const char data[size]){
+  while(size){
+    ssize_t ret = write(fd, data, size);
+    if(ret == -1 && errno == EINTR)
+      continue;
+    if(ret <= 0)
+      return -1;
+    data += ret;
+    size -= ret;
+  }
+  return 0;
+}
+
+#define S(X) sizeof(X)-1, X
+
+/** Check which events the handler of a control string gets, and that its content is passed on in bounded chunks. */
+static int check_string_events(int pane, int fd){
+  char payload[5000];
+  for(size_t i=0; i<sizeof(payload); i++)
+    payload[i] = 'a' + i % 26;
+  // The payload is written in two parts, it has to be passed on across the read boundary
+  if( write_all(fd, S(ESC "_")) == -1
+   || write_all(fd, sizeof(payload)/2, payload) == -1
+  ) return -1;
+  settle(pane);
+  if( write_all(fd, sizeof(payload) - sizeof(payload)/2, payload + sizeof(payload)/2) == -1
+   || write_all(fd, S(ST)) == -1
+  ) return -1;
+  settle(pane);
+  int result = 0;
+  const char* events = string_log.event;
+  if(events[0] != 'S' || string_log.event_count < 7 || strspn(events+1, "D") != string_log.event_count - 2 || events[string_log.event_count-1] != 'E'){
+    fprintf(stderr, "long string: unexpected events %s\n", events);
+    result = -1;
+  }
+  if(string_log.bad_chunk){
+    fprintf(stderr, "long string: a chunk was empty or larger than %d bytes\n", STRING_CHUNK_SIZE);
+    result = -1;
+  }
+  if(string_log.size != sizeof(payload) || memcmp(string_log.data, payload, sizeof(payload))){
+    fprintf(stderr, "long string: the content got corrupted\n");
+    result = -1;
+  }
+  // Strings are aborted by CAN and SUB, the text after them is printed
+  static const struct {
+    const char* name;
+    size_t size;
+    const char* sequence;
+    const char* events;
+  } abort_list[] = {
+    { "CAN", S(ESC "_abc\x18x"), "SDA" },
+    { "SUB", S(ESC "_abc\x1Ay"), "SDA" },
+    { "empty", S(ESC "_" ST), "SE" },
+  };
+  for(size_t i=0; i<sizeof(abort_list)/sizeof(*abort_list); i++){
+    string_log = (struct string_log){0};
+    if(write_all(fd, abort_list[i].size, abort_list[i].sequence) == -1)
+      return -1;
+    settle(pane);
+    if(strcmp(string_log.event, abort_list[i].events)){
+      fprintf(stderr, "%s: expected events %s, got %s\n", abort_list[i].name, abort_list[i].events, string_log.event);
+      result = -1;
+    }
+  }
+  return result;
+}
+
+/** Check the title set using OSC 0 and OSC 2. */
+static int check_title(int pane, int fd){
+  static const struct {
+    size_t size;
+    const char* sequence;
+    const char* title;
+  } list[] = {
+    { S(OSC "2;first title" "\7"), "first title" },
+    { S(OSC "0;second title" ST), "second title" },
+    { S(OSC "1;icon name" ST), "second title" },
+    { S(OSC "2;aborted\x18"), "second title" },
+    { S(OSC "2;" ST), "" },
+  };
+  int result = 0;
+  for(size_t i=0; i<sizeof(list)/sizeof(*list); i++){
+    if(write_all(fd, list[i].size, list[i].sequence) == -1)
+      return -1;
+    settle(pane);
+    char title[64];
+    int ret = tym_pane_get_title(pane, sizeof(title), title);
+    if(ret != (int)strlen(list[i].title) || strcmp(title, list[i].title)){
+      fprintf(stderr, "expected title \"%s\", got %d \"%s\"\n", list[i].title, ret, title);
+      result = -1;
+    }
+  }
+  // A title which doesn't fit is truncated, but its whole length is returned
+  if(write_all(fd, S(OSC "2;0123456789" ST)) == -1)
+    return -1;
+  settle(pane);
+  char title[5];
+  int ret = tym_pane_get_title(pane, sizeof(title), title);
+  if(ret != 10 || strcmp(title, "0123")){
+    fprintf(stderr, "expected truncated title 10 \"0123\", got %d \"%s\"\n", ret, title);
+    result = -1;
+  }
+  return result;
+}
+
+/** A chunk of data which can be told apart from all other chunks */
+static void send_chunk(size_t index, char chunk[SEND_CHUNK_SIZE]){
+  snprintf(chunk, SEND_CHUNK_SIZE, "%.8zu", index);
+  for(size_t i=8; i<SEND_CHUNK_SIZE; i++)
+    chunk[i] = 'a' + (index + i) % 26;
+}
+
+/** Let the input of a pane reach its program unchanged, and don't echo it. */
+static int make_raw(int fd){
+  struct termios t;
+  if(tcgetattr(fd, &t) == -1)
+    return -1;
+  cfmakeraw(&t);
+  return tcsetattr(fd, TCSANOW, &t);
+}
+
+/** Read the input of the pane until nothing more arrives for a while. Returns the number of bytes read. */
+static size_t read_input(int fd, size_t capacity, char buffer[capacity]){
+  size_t size = 0;
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  while(size < capacity && poll(&pfd, 1, 200) == 1){
+    ssize_t ret = read(fd, buffer + size, capacity - size);
+    if(ret <= 0)
+      break;
+    size += ret;
+  }
+  return size;
+}
+
+/**
+ * Read the input of the pane until nothing more arrives for a while, and check that
+ * it's made up of the chunks in the list, in order.
+ */
+static int check_received(int fd, size_t count, const size_t list[count]){
+  size_t capacity = count * SEND_CHUNK_SIZE + 1;
+  char* buffer = malloc(capacity);
+  if(!buffer)
+    return -1;
+  size_t size = read_input(fd, capacity, buffer);
+  int result = 0;
+  if(size != count * SEND_CHUNK_SIZE){
+    fprintf(stderr, "expected %zu bytes, got %zu\n", count * SEND_CHUNK_SIZE, size);
+    result = -1;
+  }
+  for(size_t i=0; i<count && (i+1) * SEND_CHUNK_SIZE <= size; i++){
+    char chunk[SEND_CHUNK_SIZE];
+    send_chunk(list[i], chunk);
+    if(memcmp(buffer + i * SEND_CHUNK_SIZE, chunk, SEND_CHUNK_SIZE)){
+      fprintf(stderr, "chunk %zu should have been chunk %zu, got %.8s\n", i, list[i], buffer + i * SEND_CHUNK_SIZE);
+      result = -1;
+      break;
+    }
+  }
+  free(buffer);
+  return result;
+}
+
+/**
+ * Send chunks to a pane whose program doesn't read its input, until the next one wouldn't fit
+ * into the queue anymore. The chunks sent are added to list. Returns -1 if the queue never filled up.
+ */
+static int fill_send_queue(int pane, int fd, size_t* count, size_t list[SEND_CHUNK_MAX]){
+  if(make_raw(fd) == -1)
+    return -1;
+  for(size_t i=0; i<SEND_CHUNK_MAX; i++){
+    char chunk[SEND_CHUNK_SIZE];
+    send_chunk(i, chunk);
+    struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+    if(!ppane)
+      return -1;
+    size_t queued = ppane->send_queue.size;
+    tym_i_pane_release(ppane);
+    if(queued + SEND_CHUNK_SIZE > SEND_QUEUE_LIMIT)
+      return 0;
+    if(tym_pane_type(pane, SEND_CHUNK_SIZE, chunk) == -1){
+      perror("tym_pane_type failed");
+      return -1;
+    }
+    list[(*count)++] = i;
+  }
+  fprintf(stderr, "the program didn't read its input, but nothing was queued\n");
+  return -1;
+}
+
+/** The size of the send queue of a pane */
+static size_t send_queue_size(int pane){
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane)
+    return 0;
+  size_t size = ppane->send_queue.size;
+  tym_i_pane_release(ppane);
+  return size;
+}
+
+static int setup_send_queue_fail(void){
+  return tym_set_send_queue_limit(SEND_QUEUE_LIMIT, TYM_SEND_OVERFLOW_FAIL);
+}
+
+/**
+ * Check that data which doesn't fit into the queue anymore isn't sent & an error is reported,
+ * and that the queued data is written in order once the program reads its input.
+ */
+static int check_send_queue_fail(int pane, int fd){
+  static size_t list[SEND_CHUNK_MAX];
+  size_t count = 0;
+  if(fill_send_queue(pane, fd, &count, list) == -1)
+    return -1;
+  int result = 0;
+  char chunk[SEND_CHUNK_SIZE];
+  send_chunk(SEND_CHUNK_MAX, chunk);
+  errno = 0;
+  if(tym_pane_type(pane, SEND_CHUNK_SIZE, chunk) != -1 || errno != EAGAIN){
+    fprintf(stderr, "sending more than fits into the queue didn't fail with EAGAIN\n");
+    result = -1;
+  }
+  if(send_queue_size(pane) > SEND_QUEUE_LIMIT){
+    fprintf(stderr, "more than %d bytes were queued\n", SEND_QUEUE_LIMIT);
+    result = -1;
+  }
+  if(check_received(fd, count, list) == -1)
+    result = -1;
+  if(send_queue_size(pane)){
+    fprintf(stderr, "the queue wasn't written\n");
+    result = -1;
+  }
+  return result;
+}
+
+static int setup_send_queue_discard(void){
+  return tym_set_send_queue_limit(SEND_QUEUE_LIMIT, TYM_SEND_OVERFLOW_DISCARD);
+}
+
+/**
+ * Check that data which doesn't fit into the queue anymore is dropped silently, and that
+ * the queue is used again once the program read its input.
+ */
+static int check_send_queue_discard(int pane, int fd){
+  static size_t list[SEND_CHUNK_MAX];
+  size_t count = 0;
+  if(fill_send_queue(pane, fd, &count, list) == -1)
+    return -1;
+  int result = 0;
+  for(size_t i=0; i<3; i++){
+    char chunk[SEND_CHUNK_SIZE];
+    send_chunk(SEND_CHUNK_MAX + i, chunk);
+    if(tym_pane_type(pane, SEND_CHUNK_SIZE, chunk) == -1){
+      perror("sending more than fits into the queue failed");
+      result = -1;
+    }
+  }
+  if(send_queue_size(pane) > SEND_QUEUE_LIMIT){
+    fprintf(stderr, "more than %d bytes were queued\n", SEND_QUEUE_LIMIT);
+    result = -1;
+  }
+  if(check_received(fd, count, list) == -1)
+    result = -1;
+  char chunk[SEND_CHUNK_SIZE];
+  send_chunk(SEND_CHUNK_MAX + 3, chunk);
+  if(tym_pane_type(pane, SEND_CHUNK_SIZE, chunk) == -1){
+    perror("tym_pane_type failed");
+    result = -1;
+  }
+  if(check_received(fd, 1, (size_t[]){SEND_CHUNK_MAX + 3}) == -1)
+    result = -1;
+  return result;
+}
+
+enum {
+  /** A send queue limit smaller than the chunks pasted text is passed on in */
+  PASTE_SMALL_QUEUE_LIMIT = 1000,
+  /** The size of the text pasted by the paste checks, more than fits into the pseudo terminal */
+  PASTE_SIZE = 256 * 1024
+};
+
+/** Paste text into a pane in bracketed paste mode, and read what its program got into input. Returns what tym_pane_paste returned. */
+static int paste_bracketed(int pane, int fd, char text[PASTE_SIZE], size_t capacity, char input[capacity], size_t* size){
+  if(make_raw(fd) == -1 || write_all(fd, S(CSI "?2004h")) == -1)
+    return -1;
+  settle(pane);
+  for(size_t i=0; i<PASTE_SIZE; i++)
+    text[i] = 'a' + i % 26;
+  errno = 0;
+  int ret = tym_pane_paste(pane, PASTE_SIZE, text);
+  if(ret == -1 && errno != EAGAIN){
+    perror("tym_pane_paste failed");
+    return -1;
+  }
+  *size = read_input(fd, capacity, input);
+  return ret;
+}
+
+static int setup_paste_small_queue(void){
+  return tym_set_send_queue_limit(PASTE_SMALL_QUEUE_LIMIT, TYM_SEND_OVERFLOW_DISCARD);
+}
+
+/** Check that no pasted text is lost if the send queue is smaller than the chunks the text is passed on in. */
+static int check_paste_small_queue(int pane, int fd){
+  static char text[PASTE_SIZE], input[PASTE_SIZE + 64];
+  size_t size = 0;
+  if(paste_bracketed(pane, fd, text, sizeof(input), input, &size) == -1)
+    return -1;
+  const size_t marker = sizeof(CSI "200~") - 1;
+  if( size != PASTE_SIZE + 2 * marker
+   || memcmp(input, CSI "200~", marker)
+   || memcmp(input + marker, text, PASTE_SIZE)
+   || memcmp(input + marker + PASTE_SIZE, CSI "201~", marker)
+  ){
+    fprintf(stderr, "expected %zu bytes of pasted text, got %zu\n", PASTE_SIZE + 2 * marker, size);
+    return -1;
+  }
+  return 0;
+}
+
+static int setup_paste_no_queue(void){
+  return tym_set_send_queue_limit(0, TYM_SEND_OVERFLOW_FAIL);
+}
+
+/** Check that the end marker of bracketed paste mode is sent even if the rest of the text can't be. */
+static int check_paste_no_queue(int pane, int fd){
+  static char text[PASTE_SIZE], input[PASTE_SIZE + 64];
+  size_t size = 0;
+  int ret = paste_bracketed(pane, fd, text, sizeof(input), input, &size);
+  if(ret == -1 && errno != EAGAIN)
+    return -1;
+  const size_t marker = sizeof(CSI "200~") - 1;
+  if( size < 2 * marker
+   || memcmp(input, CSI "200~", marker)
+   || memcmp(input + marker, text, size - 2 * marker)
+   || memcmp(input + size - marker, CSI "201~", marker)
+  ){
+    fprintf(stderr, "the pasted text got corrupted, or the end marker is missing\n");
+    return -1;
+  }
+  if(ret != -1 && size != PASTE_SIZE + 2 * marker){
+    fprintf(stderr, "some of the text was lost, but no error was reported\n");
+    return -1;
+  }
+  return 0;
+}
+
+/** How often the escape sequences with the specified handler were handled */
+static uint64_t sequence_count(const struct tym_pane_stats* stats, const char* name){
+  uint64_t count = 0;
+  for(size_t i=0; i<stats->sequence_count; i++)
+    if(!strcmp(tym_sequence_name(i), name))
+      count += stats->sequence[i];
+  return count;
+}
+
+/** Check that the counters of a pane count what the program in it wrote. */
+static int check_stats(int pane, int fd){
+  static const char output[] = "a" CSI "1;31m" "b" CSI "0m" "\xFF" "c" CSI "99y" "\xC3" "d";
+  size_t count = tym_i_command_sequence_map_count;
+  uint64_t before_list[count], after_list[count];
+  struct tym_pane_stats before = { .sequence_count = count, .sequence = before_list };
+  struct tym_pane_stats after = { .sequence_count = count, .sequence = after_list };
+  if(tym_pane_get_stats(pane, &before) == -1)
+    return -1;
+  if(write_all(fd, S(output)) == -1)
+    return -1;
+  settle(pane);
+  if(tym_pane_get_stats(pane, &after) == -1)
+    return -1;
+  int result = 0;
+  if(after.bytes_read - before.bytes_read != sizeof(output) - 1){
+    fprintf(stderr, "bytes_read: expected %zu, got %llu\n", sizeof(output) - 1, (unsigned long long)(after.bytes_read - before.bytes_read));
+    result = -1;
+  }
+  if(after.reads == before.reads){
+    fprintf(stderr, "reads didn't change\n");
+    result = -1;
+  }
+  uint64_t handled = sequence_count(&after, "character_attribute_change") - sequence_count(&before, "character_attribute_change");
+  if(handled != 2){
+    fprintf(stderr, "character_attribute_change: expected 2, got %llu\n", (unsigned long long)handled);
+    result = -1;
+  }
+  if(after.sequences_unknown - before.sequences_unknown != 1){
+    fprintf(stderr, "sequences_unknown: expected 1, got %llu\n", (unsigned long long)(after.sequences_unknown - before.sequences_unknown));
+    result = -1;
+  }
+  if(after.utf8_invalid - before.utf8_invalid != 2){
+    fprintf(stderr, "utf8_invalid: expected 2, got %llu\n", (unsigned long long)(after.utf8_invalid - before.utf8_invalid));
+    result = -1;
+  }
+  return result;
+}
+
+static int setup_style_table(void){
+  terminal_size = (struct tym_i_cell_position){ 400, 200 };
+  return 0;
+}
+
+/**
+ * Check that a pane which uses more different character formats than fit into its style table
+ * at once doesn't write past the table, the cells which don't get a format of their own use the default one.
+ */
+static int check_style_table(int pane, int fd){
+  enum { CELL_COUNT = TYM_I_STYLE_MAX + 4464 };
+  for(unsigned i=0; i<CELL_COUNT; i++){
+    char cell[32];
+    int n = snprintf(cell, sizeof(cell), CSI "48;%u;%u;%um ", i >> 16, (i >> 8) & 0xFF, i & 0xFF);
+    if(write_all(fd, n, cell) == -1)
+      return -1;
+  }
+  settle(pane);
+  struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane);
+  if(!ppane)
+    return -1;
+  int result = 0;
+  const struct tym_i_style_table* table = &ppane->style;
+  if(table->count > table->capacity || table->capacity > TYM_I_STYLE_MAX){
+    fprintf(stderr, "the style table holds %zu formats, but only has space for %zu\n", table->count, table->capacity);
+    result = -1;
+  }
+  const struct tym_i_pane_screen_state* screen = &ppane->screen[ppane->current_screen];
+  uint16_t last = tym_i_screen_line(screen, (CELL_COUNT - 1) / terminal_size.x)[(CELL_COUNT - 1) % terminal_size.x].style;
+  if(last){
+    fprintf(stderr, "the last cell should have the default format, but has format %u\n", (unsigned)last);
+    result = -1;
+  }
+  tym_i_pane_release(ppane);
+  return result;
+}
+
+enum {
+  /** The number of workers the worker checks parse the output of the panes with, see tym_set_parser_thread_count */
+  WORKER_COUNT = 4,
+  /** The number of panes the worker checks write to at once */
+  WORKER_PANE_COUNT = 4,
+  /** The number of lines written to each pane by check_workers_order */
+  WORKER_LINE_COUNT = 2000
+};
+
+static int setup_workers(void){
+  return tym_set_parser_thread_count(WORKER_COUNT);
+}
+
+/** Wait up to a second until a pane has read the specified number of bytes in total */
+static int wait_bytes_read(int pane, uint64_t bytes){
+  for(int i=0; i<1000; i++){
+    struct tym_pane_stats stats = {0};
+    if(tym_pane_get_stats(pane, &stats) == -1)
+      return -1;
+    if(stats.bytes_read >= bytes)
+      return 0;
+    usleep(1000);
+  }
+  fprintf(stderr, "the pane didn't read all %llu bytes written to it\n", (unsigned long long)bytes);
+  return -1;
+}
+
+/** Copy the text of a row of the current screen of a pane. The lock of the pane has to be held. */
+static void screen_row(const struct tym_i_pane_internal* pane, unsigned y, size_t size, char text[size]){
+  const struct tym_i_pane_screen_state* screen = &pane->screen[pane->current_screen];
+  const struct tym_i_cell* line = tym_i_screen_line(screen, y);
+  size_t n = 0;
+  for(unsigned x=0; x<screen->grid.size.x && line[x].glyph[0] && n<size-1; x++)
+    text[n++] = line[x].glyph[0];
+  text[n] = 0;
+}
+
+/**
+ * Check that the output of panes processed by different workers at the same time is parsed in order.
+ * The lines are written to all the panes in turns, in many small writes, so that they're read in many parts.
+ */
+static int check_workers_order(int pane, int fd){
+  int pane_list[WORKER_PANE_COUNT] = {pane};
+  int fd_list[WORKER_PANE_COUNT] = {fd};
+  for(size_t i=1; i<WORKER_PANE_COUNT; i++){
+    pane_list[i] = tym_pane_create(&top_pane_coordinates);
+    if(pane_list[i] == -1){
+      perror("tym_pane_create failed");
+      return -1;
+    }
+    fd_list[i] = tym_pane_get_slavefd(pane_list[i]);
+  }
+  for(unsigned line=0; line<WORKER_LINE_COUNT; line++){
+    for(size_t i=0; i<WORKER_PANE_COUNT; i++){
+      char text[32];
+      int n = snprintf(text, sizeof(text), "\r\n%zu:%u", i, line);
+      if(write_all(fd_list[i], n, text) == -1)
+        return -1;
+    }
+  }
+  int result = 0;
+  for(size_t i=0; i<WORKER_PANE_COUNT; i++){
+    settle(pane_list[i]);
+    struct tym_i_pane_internal* ppane = tym_i_pane_acquire(pane_list[i]);
+    if(!ppane)
+      return -1;
+    // The last lines written are the rows of the screen
+    for(unsigned y=0; y<terminal_size.y; y++){
+      char expected[32], text[32];
+      snprintf(expected, sizeof(expected), "%zu:%u", i, WORKER_LINE_COUNT - terminal_size.y + y);
+      screen_row(ppane, y, sizeof(text), text);
+      if(strcmp(text, expected)){
+        fprintf(stderr, "pane %zu, row %u: expected %s, got %s\n", i, y, expected, text);
+        result = -1;
+        break;
+      }
+    }
+    tym_i_pane_release(ppane);
+  }
+  return result;
+}
+
+/** Check that the pseudo terminal master of a pane is watched again after each time a worker read from it. */
+static int check_workers_rearm(int pane, int fd){
+  for(unsigned i=0; i<200; i++){
+    if(write_all(fd, S("x")) == -1)
+      return -1;
+    if(wait_bytes_read(pane, i+1) == -1)
+      return -1;
+  }
+  return 0;
+}
+
+/** Check that panes can be destroyed while they're waiting for a worker or being processed by one. */
+static int check_workers_destroy(int pane, int fd){
+  char text[2048];
+  memset(text, 'x', sizeof(text));
+  for(unsigned round=0; round<50; round++){
+    int pane_list[WORKER_PANE_COUNT];
+    for(size_t i=0; i<WORKER_PANE_COUNT; i++){
+      pane_list[i] = tym_pane_create(&top_pane_coordinates);
+      if(pane_list[i] == -1){
+        perror("tym_pane_create failed");
+        return -1;
+      }
+      if(write_all(tym_pane_get_slavefd(pane_list[i]), sizeof(text), text) == -1)
+        return -1;
+    }
+    for(size_t i=0; i<WORKER_PANE_COUNT; i++){
+      if(tym_pane_destroy(pane_list[i]) == -1){
+        perror("tym_pane_destroy failed");
+        return -1;
+      }
+    }
+  }
+  // The workers have to be still around for the remaining pane
+  if(write_all(fd, S("ok")) == -1)
+    return -1;
+  return wait_bytes_read(pane, 2);
+}
+
+/**
+ * Check that the changes made by the workers are drawn by the main loop when the pane is rendered,
+ * and that scrolling the pane still reaches the backend.
+ */
+static int check_workers_render(int pane, int fd){
+  if(write_all(fd, S("hello")) == -1)
+    return -1;
+  settle(pane);
+  pthread_mutex_lock(&tym_i_backend_lock);
+  struct draw_log log = draw_log;
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  int result = 0;
+  if(log.characters < 5){
+    fprintf(stderr, "expected at least 5 characters to be drawn, got %zu\n", log.characters);
+    result = -1;
+  }
+  // The cursor is in the first row, 30 more lines scroll the pane up by all but the rows below it
+  for(unsigned i=0; i<30; i++)
+    if(write_all(fd, S("\r\nline")) == -1)
+      return -1;
+  settle(pane);
+  pthread_mutex_lock(&tym_i_backend_lock);
+  log = draw_log;
+  pthread_mutex_unlock(&tym_i_backend_lock);
+  if(log.scrolled != 30 - (long)(terminal_size.y - 1)){
+    fprintf(stderr, "expected the pane to be scrolled by %ld rows, got %ld\n", 30 - (long)(terminal_size.y - 1), log.scrolled);
+    result = -1;
+  }
+  if(log.off_main_loop){
+    fprintf(stderr, "something was drawn outside of the main loop\n");
+    result = -1;
+  }
+  return result;
+}
+
+static const struct {
+  const char* name;
+  int (*check)(int pane, int fd);
+  /** Called before libttymultiplex is initialised, may be a null pointer */
+  int (*setup)(void);
+} check_list[] = {
+  { "string-events", check_string_events, 0 },
+  { "title", check_title, 0 },
+  { "send-queue-fail", check_send_queue_fail, setup_send_queue_fail },
+  { "send-queue-discard", check_send_queue_discard, setup_send_queue_discard },
+  { "stats", check_stats, 0 },
+  { "style-table", check_style_table, setup_style_table },
+  { "paste-small-queue", check_paste_small_queue, setup_paste_small_queue },
+  { "paste-no-queue", check_paste_no_queue, setup_paste_no_queue },
+  { "workers-order", check_workers_order, setup_workers },
+  { "workers-rearm", check_workers_rearm, setup_workers },
+  { "workers-destroy", check_workers_destroy, setup_workers },
+  { "workers-render", check_workers_render, setup_workers },
+};
+
+int main(int argc, char* argv[]){
+  if(argc != 2){
+    fprintf(stderr, "Usage: %s check\n", argv[0]);
+    return 1;
+  }
+  size_t i = 0;
+  while(i < sizeof(check_list)/sizeof(*check_list) && strcmp(check_list[i].name, argv[1]))
+    i++;
+  if(i == sizeof(check_list)/sizeof(*check_list)){
+    fprintf(stderr, "unknown check %s\n", argv[1]);
+    return 1;
+  }
+  if(setenv("TM_BACKEND", TYM_I_BACKEND_NAME, true) == -1){
+    perror("setenv failed");
+    return 1;
+  }
+  if(tym_set_string_chunk_size(STRING_CHUNK_SIZE) == -1){
+    perror("tym_set_string_chunk_size failed");
+    return 1;
+  }
+  if(check_list[i].setup && check_list[i].setup() == -1){
+    perror("setup failed");
+    return 1;
+  }
+  if(tym_init()){
+    perror("tym_init failed");
+    return 1;
+  }
+  int top_pane = tym_pane_create(&top_pane_coordinates);
+  if(top_pane == -1){
+    perror("tym_create_pane failed");
+    return 1;
+  }
+  int fd = tym_pane_get_slavefd(top_pane);
+  int ret = check_list[i].check(top_pane, fd);
+  tym_shutdown();
+  return ret == -1;
+}
+
+static int update_terminal_size_information(void){
+  TYM_POS_REF(tym_i_bounds.edge[TYM_RECT_BOTTOM_RIGHT], CHARFIELD, TYM_AXIS_HORIZONTAL) = terminal_size.x;
+  TYM_POS_REF(tym_i_bounds.edge[TYM_RECT_BOTTOM_RIGHT], CHARFIELD, TYM_AXIS_VERTICAL  ) = terminal_size.y;
+  return 0;
+}
+
+static int init(struct tym_i_backend_capabilities* caps){
+  (void)caps;
+  return 0;
+}
+
+static int cleanup(bool zap){
+  (void)zap;
+  return 0;
+}
+
+static int resize(void){
+  return 0;
+}
+
+static int pane_create(struct tym_i_pane_internal* pane){
+  (void)pane;
+  return 0;
+}
+
+static void pane_destroy(struct tym_i_pane_internal* pane){
+  (void)pane;
+}
+
+static int pane_resize(struct tym_i_pane_internal* pane){
+  (void)pane;
+  return 0;
+}
+
+static int pane_set_cursor_position(struct tym_i_pane_internal* pane, struct tym_i_cell_position position){
+  (void)pane;
+  (void)position;
+  return 0;
+}
+
+static int pane_set_character(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t length, const char utf8[length+1],
+  bool insert
+){
+  (void)pane;
+  (void)position;
+  (void)format;
+  (void)length;
+  (void)utf8;
+  (void)insert;
+  draw_log.characters++;
+  if(!pthread_equal(pthread_self(), tym_i_main_loop))
+    draw_log.off_main_loop = true;
+  return 0;
+}
+
+static int pane_scroll(struct tym_i_pane_internal* pane, int n){
+  (void)pane;
+  draw_log.scrolled += n;
+  if(!pthread_equal(pthread_self(), tym_i_main_loop))
+    draw_log.off_main_loop = true;
+  return 0;
+}
+
+TYM_I_BACKEND_REGISTER((
+  .init = init,
+  .cleanup = cleanup,
+  .resize = resize,
+  .pane_create = pane_create,
+  .pane_destroy = pane_destroy,
+  .pane_resize = pane_resize,
+  .pane_set_cursor_position = pane_set_cursor_position,
+  .pane_set_character = pane_set_character,
+  .pane_scroll = pane_scroll,
+  .update_terminal_size_information = update_terminal_size_information
+))
@@ -0,0 +1,422 @@
+// Copyright (c) 2018 Daniel Abrecht
+// SPDX-License-Identifier: AGPL-3.0-or-later
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include <internal/main.h>
+#include <internal/pane.h>
+#include <internal/backend.h>
+
+/**
+ * \file
+ *
+ * Keystroke to screen latency measurements.
+ * A child process echoes everything it reads from the slave of the probe pane back to it.
+ * Keys are sent to the probe pane using tym_pane_send_key, and the time is measured until
+ * the echoed character reaches the backend, and until the probe pane is rendered afterwards.
+ * Meanwhile, other panes can be flooded with output to simulate background load.
+ * This program contains its own backend, which does nothing but take the timestamps.
+ * If the output is parsed by workers, nothing is drawn until the pane is rendered,
+ * only the time until then is measured.
+ */
+
+enum {
+  /** The maximum number of panes with background load */
+  LOAD_PANE_MAX = 16,
+  /** The size of the chunks written to the panes with background load */
+  LOAD_CHUNK_SIZE = 4096,
+};
+
+enum probe_state {
+  PROBE_IDLE,
+  PROBE_SENT,
+  PROBE_PARSED,
+  PROBE_RENDERED,
+};
+
+/** The state of the current measurement, protected by probe.lock */
+static struct {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  enum probe_state state;
+  int pane;
+  struct timespec sent, parsed, rendered;
+} probe = {
+  .lock = PTHREAD_MUTEX_INITIALIZER,
+  .pane = -1,
+};
+
+struct load {
+  pthread_t thread;
+  int fd;
+  unsigned rate;
+};
+
+static volatile bool stop_load;
+/** Set if the output is parsed by workers, see tym_set_parser_thread_count */
+static bool deferred;
+
+static const struct tym_i_cell_position screen_size = { .x = 80, .y = 48 };
+
+static long long elapsed(struct timespec start, struct timespec end){
+  return (end.tv_sec - start.tv_sec) * 1000000000ll + (end.tv_nsec - start.tv_nsec);
+}
+
+static void probe_arrived(const struct tym_i_pane_internal* pane){
+  pthread_mutex_lock(&probe.lock);
+  if(pane->id == probe.pane && probe.state == PROBE_SENT){
+    clock_gettime(CLOCK_MONOTONIC, &probe.parsed);
+    probe.state = PROBE_PARSED;
+  }
+  pthread_mutex_unlock(&probe.lock);
+}
+
+static void probe_rendered(const struct tym_i_pane_internal* pane){
+  pthread_mutex_lock(&probe.lock);
+  if(pane->id == probe.pane && (probe.state == PROBE_PARSED || (deferred && probe.state == PROBE_SENT))){
+    clock_gettime(CLOCK_MONOTONIC, &probe.rendered);
+    probe.state = PROBE_RENDERED;
+    pthread_cond_signal(&probe.cond);
+  }
+  pthread_mutex_unlock(&probe.lock);
+}
+
+/** The echo program. Only async signal safe functions may be used here, it's a child of a multithreaded process. */
+static void echo(int fd){
+  char buf[256];
+  ssize_t n;
+  while((n = read(fd, buf, sizeof(buf))) > 0 || (n == -1 && errno == EINTR))
+    if(n > 0 && write(fd, buf, n) != n)
+      break;
+  _exit(0);
+}
+
+/** Write colored log lines to a pane until stop_load is set, at most rate KiB/s if rate isn't 0 */
+static void* load_generator(void* arg){
+  const struct load* load = arg;
+  char chunk[LOAD_CHUNK_SIZE];
+  size_t size = 0;
+  for(unsigned i=0; size + 64 < sizeof(chunk); i++)
+    size += snprintf(chunk + size, sizeof(chunk) - size, "\033[3%um%08u\033[0m the quick brown fox jumps over\r\n", i % 8, i);
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  unsigned long long written = 0;
+  while(!stop_load){
+    ssize_t n = write(load->fd, chunk, size);
+    if(n == -1){
+      if(errno == EINTR || errno == EAGAIN)
+        continue;
+      break;
+    }
+    written += n;
+    if(load->rate){
+      struct timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      long long ahead = written * 1000000000ull / (load->rate * 1024ull) - elapsed(start, now);
+      if(ahead > 0)
+        nanosleep(&(struct timespec){ .tv_sec = ahead / 1000000000, .tv_nsec = ahead % 1000000000 }, 0);
+    }
+  }
+  return 0;
+}
+
+static int compare(const void* a, const void* b){
+  long long x = *(const long long*)a;
+  long long y = *(const long long*)b;
+  return (x > y) - (x < y);
+}
+
+static void report(const char* stage, size_t count, long long sample[count]){
+  qsort(sample, count, sizeof(*sample), compare);
+  const double p[] = { 0.5, 0.99, 0.999 };
+  printf("%-9s", stage);
+  for(size_t i=0; i<sizeof(p)/sizeof(*p); i++){
+    size_t j = p[i] * count;
+    if(j >= count)
+      j = count - 1;
+    printf(" %10.1f", sample[j] / 1000.);
+  }
+  printf(" %10.1f\n", sample[count-1] / 1000.);
+}
+
+static void usage(const char* name){
+  fprintf(stderr,
+    "Usage: %s [-n samples] [-i ms] [-l panes] [-r KiB/s] [-f fps] [-w threads] [-b bytes]\n"
+    "  -n  The number of keys to send, default 1000\n"
+    "  -i  The time to wait between keys, default 30\n"
+    "  -l  The number of panes with background load, default 0\n"
+    "  -r  The amount of output per pane with background load, default 0 (unlimited)\n"
+    "  -f  The render rate, see tym_set_render_rate, default %u\n"
+    "  -w  The number of parser threads, see tym_set_parser_thread_count, default 0\n"
+    "  -b  The read quantum of the panes in bytes, see tym_set_read_budget, default %u\n",
+    name, TYM_I_DEFAULT_RENDER_RATE, TYM_I_DEFAULT_READ_QUANTUM
+  );
+}
+
+int main(int argc, char* argv[]){
+  unsigned count = 1000;
+  unsigned interval = 30;
+  unsigned load_count = 0;
+  unsigned rate = 0;
+  unsigned fps = TYM_I_DEFAULT_RENDER_RATE;
+  unsigned workers = 0;
+  size_t quantum = TYM_I_DEFAULT_READ_QUANTUM;
+  int opt;
+  while((opt = getopt(argc, argv, "n:i:l:r:f:w:b:h")) != -1){
+    switch(opt){
+      case 'n': count = strtoul(optarg, 0, 10); break;
+      case 'i': interval = strtoul(optarg, 0, 10); break;
+      case 'l': load_count = strtoul(optarg, 0, 10); break;
+      case 'r': rate = strtoul(optarg, 0, 10); break;
+      case 'f': fps = strtoul(optarg, 0, 10); break;
+      case 'w': workers = strtoul(optarg, 0, 10); break;
+      case 'b': quantum = strtoul(optarg, 0, 10); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if(!count || load_count > LOAD_PANE_MAX || optind != argc){
+    usage(argv[0]);
+    return 1;
+  }
+
+  long long* parsed = calloc(count, sizeof(*parsed));
+  long long* rendered = calloc(count, sizeof(*rendered));
+  if(!parsed || !rendered){
+    perror("calloc failed");
+    return 1;
+  }
+  pthread_condattr_t condattr;
+  pthread_condattr_init(&condattr);
+  pthread_condattr_setclock(&condattr, CLOCK_MONOTONIC);
+  pthread_cond_init(&probe.cond, &condattr);
+  pthread_condattr_destroy(&condattr);
+
+  setenv("TM_BACKEND", TYM_I_BACKEND_NAME, true);
+  if(tym_set_parser_thread_count(workers) == -1){
+    perror("tym_set_parser_thread_count failed");
+    return 1;
+  }
+  deferred = workers;
+  if(tym_set_read_budget(quantum, quantum > TYM_I_DEFAULT_READ_BUDGET_MAX ? quantum : TYM_I_DEFAULT_READ_BUDGET_MAX) == -1){
+    perror("tym_set_read_budget failed");
+    return 1;
+  }
+  if(tym_init()){
+    perror("tym_init failed");
+    return 1;
+  }
+  if(tym_set_render_rate(fps) == -1){
+    perror("tym_set_render_rate failed");
+    return 1;
+  }
+
+  // The probe pane gets the upper half of the screen, the panes with background load share the lower half.
+  double split = load_count ? 0.5 : 1;
+  int pane = tym_pane_create(&(struct tym_super_position_rectangle){
+    .edge[TYM_RECT_BOTTOM_RIGHT].type[TYM_P_RATIO].axis = {
+      [TYM_AXIS_HORIZONTAL].value.real = 1,
+      [TYM_AXIS_VERTICAL].value.real = split,
+    }
+  });
+  if(pane == -1){
+    perror("tym_pane_create failed");
+    return 1;
+  }
+  if(tym_pane_set_flag(pane, TYM_PF_FOCUS, true) == -1){
+    perror("tym_pane_set_flag failed");
+    return 1;
+  }
+  int slave = tym_pane_get_slavefd(pane);
+  struct termios termios;
+  if(slave == -1 || tcgetattr(slave, &termios) == -1){
+    perror("tcgetattr failed");
+    return 1;
+  }
+  cfmakeraw(&termios);
+  if(tcsetattr(slave, TCSANOW, &termios) == -1){
+    perror("tcsetattr failed");
+    return 1;
+  }
+  pid_t child = fork();
+  if(child == -1){
+    perror("fork failed");
+    return 1;
+  }
+  if(!child)
+    echo(slave);
+
+  struct load load[LOAD_PANE_MAX];
+  for(unsigned i=0; i<load_count; i++){
+    int lpane = tym_pane_create(&(struct tym_super_position_rectangle){
+      .edge = {
+        [TYM_RECT_TOP_LEFT].type[TYM_P_RATIO].axis[TYM_AXIS_VERTICAL].value.real = split + split * i / load_count,
+        [TYM_RECT_BOTTOM_RIGHT].type[TYM_P_RATIO].axis = {
+          [TYM_AXIS_HORIZONTAL].value.real = 1,
+          [TYM_AXIS_VERTICAL].value.real = split + split * (i + 1) / load_count,
+        },
+      }
+    });
+    if(lpane == -1){
+      perror("tym_pane_create failed");
+      return 1;
+    }
+    load[i] = (struct load){ .fd = tym_pane_get_slavefd(lpane), .rate = rate };
+    if(pthread_create(&load[i].thread, 0, load_generator, load + i)){
+      perror("pthread_create failed");
+      return 1;
+    }
+  }
+
+  unsigned lost = 0;
+  size_t n = 0;
+  for(unsigned i=0; i<count; i++){
+    usleep(interval * 1000);
+    pthread_mutex_lock(&probe.lock);
+    probe.pane = pane;
+    probe.state = PROBE_SENT;
+    clock_gettime(CLOCK_MONOTONIC, &probe.sent);
+    pthread_mutex_unlock(&probe.lock);
+    if(tym_pane_send_key(pane, 'a' + i % 26) == -1){
+      perror("tym_pane_send_key failed");
+      return 1;
+    }
+    pthread_mutex_lock(&probe.lock);
+    struct timespec timeout;
+    clock_gettime(CLOCK_MONOTONIC, &timeout);
+    timeout.tv_sec += 1;
+    while(probe.state != PROBE_RENDERED)
+      if(pthread_cond_timedwait(&probe.cond, &probe.lock, &timeout) == ETIMEDOUT)
+        break;
+    if(probe.state == PROBE_RENDERED){
+      parsed[n] = elapsed(probe.sent, probe.parsed);
+      rendered[n] = elapsed(probe.sent, probe.rendered);
+      n++;
+    }else{
+      lost++;
+    }
+    probe.state = PROBE_IDLE;
+    pthread_mutex_unlock(&probe.lock);
+  }
+
+  stop_load = true;
+  for(unsigned i=0; i<load_count; i++)
+    pthread_join(load[i].thread, 0);
+  // The child inherited the file descriptors of the library, it has to be gone before the main loop can notice the shutdown
+  kill(child, SIGTERM);
+  waitpid(child, 0, 0);
+  tym_shutdown();
+
+  printf("%u samples, %u lost, %u panes with %s background load, render rate %u, %u parser threads\n", count, lost, load_count, rate ? "limited" : "unlimited", fps, workers);
+  if(n){
+    printf("%-9s %10s %10s %10s %10s\n", "us", "p50", "p99", "p999", "max");
+    if(!deferred)
+      report("parsed", n, parsed);
+    report("rendered", n, rendered);
+  }
+  free(parsed);
+  free(rendered);
+  return lost ? 1 : 0;
+}
+
+static int update_terminal_size_information(void){
+  TYM_POS_REF(tym_i_bounds.edge[TYM_RECT_BOTTOM_RIGHT], CHARFIELD, TYM_AXIS_HORIZONTAL) = screen_size.x;
+  TYM_POS_REF(tym_i_bounds.edge[TYM_RECT_BOTTOM_RIGHT], CHARFIELD, TYM_AXIS_VERTICAL  ) = screen_size.y;
+  return 0;
+}
+
+static int init(struct tym_i_backend_capabilities* caps){
+  (void)caps;
+  return 0;
+}
+
+static int cleanup(bool zap){
+  (void)zap;
+  return 0;
+}
+
+static int resize(void){
+  return 0;
+}
+
+static int pane_create(struct tym_i_pane_internal* pane){
+  (void)pane;
+  return 0;
+}
+
+static void pane_destroy(struct tym_i_pane_internal* pane){
+  (void)pane;
+}
+
+static int pane_resize(struct tym_i_pane_internal* pane){
+  (void)pane;
+  return 0;
+}
+
+static int pane_set_cursor_position(struct tym_i_pane_internal* pane, struct tym_i_cell_position position){
+  (void)pane;
+  (void)position;
+  return 0;
+}
+
+static int pane_set_character(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t length, const char utf8[length+1],
+  bool insert
+){
+  (void)position;
+  (void)format;
+  (void)utf8;
+  (void)insert;
+  probe_arrived(pane);
+  return 0;
+}
+
+static int pane_set_text_run(
+  struct tym_i_pane_internal* pane,
+  struct tym_i_cell_position position,
+  struct tym_i_character_format format,
+  size_t count, size_t length, const char utf8[length]
+){
+  (void)position;
+  (void)format;
+  (void)count;
+  (void)utf8;
+  probe_arrived(pane);
+  return 0;
+}
+
+static int pane_refresh(struct tym_i_pane_internal* pane){
+  probe_rendered(pane);
+  return 0;
+}
+
+static int pane_render(struct tym_i_pane_internal* pane, size_t count, const struct tym_i_damage_span* span){
+  (void)count;
+  (void)span;
+  probe_rendered(pane);
+  return 0;
+}
+
+TYM_I_BACKEND_REGISTER((
+  .init = init,
+  .cleanup = cleanup,
+  .resize = resize,
+  .pane_create = pane_create,
+  .pane_destroy = pane_destroy,
+  .pane_resize = pane_resize,
+  .pane_refresh = pane_refresh,
+  .pane_render = pane_render,
+  .pane_set_cursor_position = pane_set_cursor_position,
+  .pane_set_character = pane_set_character,
+  .pane_set_text_run = pane_set_text_run,
+  .update_terminal_size_information = update_terminal_size_information
+))
@@ -0,0 +1,11 @@
+#!/bin/sh
+
+# Copyright (c) 2018 Daniel Abrecht
+# SPDX-License-Identifier: AGPL-3.0-or-later
+
+# Inserting and deleting characters, and scrolling a region of the screen
+printf 'abcdef\033[1;3H\033[2@\n'
+printf 'ghijkl\033[2;2H\033[2P\n'
+printf '1\n2\n3\n4\n'
+printf '\033[3;5r\033[5;1H\n5'
+printf '\033[r\033[5;1H\033[2L'
@@ -0,0 +1,19 @@
+#!/bin/sh
+
+# Copyright (c) 2018 Daniel Abrecht
+# SPDX-License-Identifier: AGPL-3.0-or-later
+
+# Unknown and malformed escape sequences, OSC and DCS strings are consumed as a whole
+printf 'a\033[99;1yb\n'
+printf 'c\033]0;some title\007d\n'
+printf 'e\033]2;other title\033\\f\n'
+printf 'g\033Pq#0;2;0;0;0\033\\h\n'
+printf 'i\033[1:2mj\n'
+printf 'k\033[12\030l\n'
+# Control strings of any length
+long=$(printf '%2000s' '' | tr ' ' x)
+printf 'o\033]2;%s\007p\n' "$long"
+printf 'q\033P1;2q%s\033\\r\n' "$long"
+printf 's\033_%s\033\\t\n' "$long"
+printf 'u\033]0;aborted\030v\n'
+printf 'm\033[0\nmn'
@@ -0,0 +1,12 @@
+#!/bin/sh
+
+# Copyright (c) 2018 Daniel Abrecht
+# SPDX-License-Identifier: AGPL-3.0-or-later
+
+# Pasted text, everything between two \1 is pasted and then shown as the program got it
+# Line breaks are sent as carriage returns
+printf 'plain:\n\001one\ntwo\r\nthree\rfour\001\n'
+# In bracketed paste mode, the text is enclosed in CSI 200 ~ and CSI 201 ~, and end markers in it are removed
+printf '\033[?2004hbracketed:\n\001a\nb\033[201~c\001\n'
+printf '\001\033[201~\033[201\001\n'
+printf '\033[?2004lunbracketed:\n\001d\033[201~e\001\n'
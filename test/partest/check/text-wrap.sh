@@ -0,0 +1,14 @@
+#!/bin/sh
+
+# Copyright (c) 2018 Daniel Abrecht
+# SPDX-License-Identifier: AGPL-3.0-or-later
+
+# Long lines of text wrap around to the next line, utf-8 characters occupy a single cell
+seq -s ' ' 1 40
+printf 'a\303\244\342\202\254\360\235\204\236b\tc\r'
+printf 'X\n\n'
+i=0
+while [ "$i" -lt 15 ]
+  do printf 'line %d\n' "$i"; i=$((i+1))
+done
+printf 'end'
@@ -2,12 +2,16 @@
 // SPDX-License-Identifier: AGPL-3.0-or-later
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
+#include <poll.h>
 #include <unistd.h>
+#include <termios.h>
 #include <internal/main.h>
 #include <internal/pane.h>
 #include <internal/backend.h>
 #include <internal/pseudoterminal.h>
+#include <settle.h>
 
 enum colorindex {
   CI_RED,
@@ -38,9 +42,43 @@ struct tym_super_position_rectangle top_pane_coordinates = {
   }
 };
 
+/**
+ * Paste text into the pane, and show what the program in the pane got on the pane,
+ * with control characters written as ^X. The input of the pane isn't echoed anymore
+ * after this, and what the program got is read until nothing more arrives for a while.
+ */
+int paste(int pane, int fd, size_t size, const char text[size]){
+  struct termios t;
+  if(tcgetattr(fd, &t) == -1)
+    return -1;
+  t.c_iflag &= ~(ICRNL|INLCR|IGNCR);
+  t.c_lflag &= ~(ECHO|ICANON);
+  if(tcsetattr(fd, TCSANOW, &t) == -1)
+    return -1;
+  settle(pane);
+  if(tym_pane_paste(pane, size, text) == -1)
+    return -1;
+  struct pollfd pfd = { .fd = fd, .events = POLLIN };
+  while(poll(&pfd, 1, 100) == 1){
+    unsigned char buf[256];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if(n <= 0)
+      return -1;
+    for(ssize_t i=0; i<n; i++){
+      if(buf[i] < 0x20 || buf[i] == 0x7F){
+        if(write(fd, (char[]){'^', buf[i] ^ 0x40}, 2) != 2)
+          return -1;
+      }else if(write(fd, &buf[i], 1) != 1){
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
 const char* dump_target = 0;
 int dump_screen(void){
-  uint8_t di = 0;
+  static uint8_t di = 0;
   static char buf[256] = {0};
   size_t len = strlen(dump_target);
   if(len > sizeof(buf)-9)
@@ -90,12 +128,17 @@ error:
 }
 
 int main(int argc, char* argv[]){
-  if(argc != 2){
-    fprintf(stderr, "Usage: %s outputfile\n\nNote: There'll be some suffixes added to dumpfile, and there are more than one\n", argv[0]);
+  if(argc != 2 && argc != 3){
+    fprintf(stderr, "Usage: %s outputfile [parser-threads]\n\nNote: There'll be some suffixes added to dumpfile, and there are more than one\n", argv[0]);
     return 1;
   }
   dump_target = argv[1];
   setenv("TM_BACKEND", TYM_I_BACKEND_NAME, true);
+  // The output is parsed by a pool of workers, and only drawn when the pane is rendered
+  if(argc == 3 && tym_set_parser_thread_count(atoi(argv[2])) == -1){
+    perror("tym_set_parser_thread_count failed");
+    return 1;
+  }
   if(tym_init()){
     perror("tym_init failed");
     return 1;
@@ -112,7 +155,20 @@ int main(int argc, char* argv[]){
   int fd = tym_pane_get_slavefd(top_pane);
   int c;
   while((c=getchar()) != EOF && c != -1){
+    if(c == 1){
+      // Everything up to the next \1 is pasted, see paste
+      char text[4096];
+      size_t size = 0;
+      while((c=getchar()) != EOF && c != 1 && size < sizeof(text))
+        text[size++] = c;
+      if(paste(top_pane, fd, size, text) == -1){
+        perror("paste failed");
+        return 1;
+      }
+      continue;
+    }
     if(c == 0){
+      settle(top_pane);
       if(dump_screen()){
         perror("dump_screen failed");
         return 1;
@@ -124,6 +180,7 @@ int main(int argc, char* argv[]){
       return 1;
     }
   }
+  settle(top_pane);
   if(dump_screen()){
     perror("dump_screen failed");
     return 1;
@@ -172,55 +229,6 @@ static int pane_resize(struct tym_i_pane_internal* pane){
   return 0;
 }
 
-static int pane_scroll_region(struct tym_i_pane_internal* pane, int n, unsigned top, unsigned bottom){
-  unsigned pt = TYM_RECT_POS_REF(pane->absolute_position, CHARFIELD, TYM_TOP);
-  unsigned pb = TYM_RECT_POS_REF(pane->absolute_position, CHARFIELD, TYM_BOTTOM);
-  unsigned pl = TYM_RECT_POS_REF(pane->absolute_position, CHARFIELD, TYM_LEFT);
-  unsigned pr = TYM_RECT_POS_REF(pane->absolute_position, CHARFIELD, TYM_RIGHT);
-  assert(pl <= pr);
-  assert(pt <= pb);
-  assert(pr <= terminal.size.x);
-  assert(pb <= terminal.size.y);
-  assert(top <= bottom);
-  assert(bottom <= pb-pt);
-  if(n == 0 || bottom-top == 0 || pr-pl == 0)
-    return 0;
-  if(bottom-top <= (unsigned)abs(n)){
-    return tym_i_backend->pane_erase_area(
-      pane,
-      (struct tym_i_cell_position){ .x=0, .y=top },
-      (struct tym_i_cell_position){ .x=pr-pl, .y=bottom },
-      true,
-      tym_i_default_character_format
-    );
-  }else{
-    struct character (*tch)[terminal.size.y][terminal.size.x] = terminal.content;
-    if(n > 0){
-      for(int i=0,m=bottom-top-n; i<m; i++)
-        memcpy( (*tch)[pt+top+i]+pl, (*tch)[pt+top+n+i]+pl, (pr-pl) * sizeof(struct character) );
-      return tym_i_backend->pane_erase_area(
-        pane,
-        (struct tym_i_cell_position){ .x=0, .y=bottom-n },
-        (struct tym_i_cell_position){ .x=pr-pl, .y=bottom-1 },
-        true,
-        tym_i_default_character_format
-      );
-    }else{
-      for(int i=0,m=bottom-top+n; i<m; i++)
-        memcpy( (*tch)[pt+bottom-i]+pl, (*tch)[pt+bottom+n-i]+pl, (pr-pl) * sizeof(struct character) );
-      return tym_i_backend->pane_erase_area(
-        pane,
-        (struct tym_i_cell_position){ .x=0, .y=top },
-        (struct tym_i_cell_position){ .x=pr-pl, .y=top-(n+1) },
-        true,
-        tym_i_default_character_format
-      );
-    }
-  }
-  assert(false);
-  return 0;
-}
-
 static int pane_set_cursor_position(struct tym_i_pane_internal* pane, struct tym_i_cell_position position){
   unsigned pt = TYM_RECT_POS_REF(pane->absolute_position, CHARFIELD, TYM_TOP);
   unsigned pb = TYM_RECT_POS_REF(pane->absolute_position, CHARFIELD, TYM_BOTTOM);
@@ -255,6 +263,9 @@ static int pane_set_character(
   assert(position.x < pr-pl);
   assert(position.y < pb-pt);
   struct character (*tch)[terminal.size.y][terminal.size.x] = terminal.content;
+  if(insert)
+    if(position.x+1 < pr-pl)
+      memmove( (*tch)[pt+position.y]+pl+position.x+1, (*tch)[pt+position.y]+pl+position.x, (pr-pl-position.x-1) * sizeof(struct character) );
   struct character* ch = &(*tch)[pt+position.y][pl+position.x];
   ch->format = format.attribute;
   ch->fgcolor[CI_RED]   = format.fgcolor.red;
@@ -263,9 +274,6 @@ static int pane_set_character(
   ch->bgcolor[CI_RED]   = format.bgcolor.red;
   ch->bgcolor[CI_GREEN] = format.bgcolor.green;
   ch->bgcolor[CI_BLUE]  = format.bgcolor.blue;
-  if(insert)
-    if(position.x+1 < pr-pl)
-      memmove( (*tch)[pt+position.y]+pl+position.x, (*tch)[pt+position.y]+pl+position.x+1, (pr-pl-position.x-1) * sizeof(struct character) );
   if(length && length <= TYM_I_UTF8_CHARACTER_MAX_BYTE_COUNT)
     memcpy(ch->data, utf8, length);
   if(length < TYM_I_UTF8_CHARACTER_MAX_BYTE_COUNT)
@@ -273,28 +281,6 @@ static int pane_set_character(
   return 0;
 }
 
-static int pane_delete_characters(struct tym_i_pane_internal* pane, struct tym_i_cell_position position, unsigned n){
-  unsigned pt = TYM_RECT_POS_REF(pane->absolute_position, CHARFIELD, TYM_TOP);
-  unsigned pb = TYM_RECT_POS_REF(pane->absolute_position, CHARFIELD, TYM_BOTTOM);
-  unsigned pl = TYM_RECT_POS_REF(pane->absolute_position, CHARFIELD, TYM_LEFT);
-  unsigned pr = TYM_RECT_POS_REF(pane->absolute_position, CHARFIELD, TYM_RIGHT);
-  assert(pl <= pr);
-  assert(pt <= pb);
-  assert(pr <= terminal.size.x);
-  assert(pb <= terminal.size.y);
-  assert(position.x < pr-pl);
-  assert(position.y < pb-pt);
-  if(pr-pl - position.x < n)
-    n = pr-pl - position.x;
-  if(!n)
-    return 0;
-  struct character (*tch)[terminal.size.y][terminal.size.x] = terminal.content;
-  if(position.x+n < pr-pl)
-    memmove( (*tch)[pt+position.y]+pl+position.x+n, (*tch)[pt+position.y]+pl+position.x, (pr-pl-position.x-n) * sizeof(struct character) );
-  memset( (*tch)[pt+position.y]+pl+position.x, 0, n * sizeof(struct character) );
-  return 0;
-}
-
 TYM_I_BACKEND_REGISTER((
   .init = init,
   .cleanup = cleanup,
@@ -302,9 +288,7 @@ TYM_I_BACKEND_REGISTER((
   .pane_create = pane_create,
   .pane_destroy = pane_destroy,
   .pane_resize = pane_resize,
-  .pane_scroll_region = pane_scroll_region,
   .pane_set_cursor_position = pane_set_cursor_position,
   .pane_set_character = pane_set_character,
-  .pane_delete_characters = pane_delete_characters,
   .update_terminal_size_information = update_terminal_size_information
 ))